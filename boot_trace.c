@@ -0,0 +1,121 @@
+#include "boot_trace.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#define BOOT_TRACE_MAGIC    0x424F4F54
+
+/* last sector of the flash, well past the end of the program */
+#define BOOT_TRACE_FLASH_OFFSET     (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t count;
+    uint32_t done;          /* bit per phase of the current boot */
+    uint32_t current[BOOT_NUM_PHASES];
+    uint32_t previous[BOOT_NUM_PHASES];
+} boot_timeline_t;
+
+/* what boot_trace_save() keeps in flash, so a chosen boot survives a power cycle too */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t count;
+    uint32_t done;
+    uint32_t timeline[BOOT_NUM_PHASES];
+} boot_record_t;
+
+/* not cleared by the runtime, so it survives a soft reset */
+static boot_timeline_t __uninitialized_ram(boot_timeline);
+
+static bool save_pending;
+
+void boot_trace_init(void)
+{
+    boot_timeline_t *t = &boot_timeline;
+    uint32_t now = time_us_32();
+
+    if (t->magic == BOOT_TRACE_MAGIC)
+    {
+        for (int i = 0; i < BOOT_NUM_PHASES; i++)
+            t->previous[i] = (t->done & (1u << i)) ? t->current[i] : 0;
+        t->count++;
+    }
+    else
+    {
+        /* power on, RAM holds garbage; a saved boot may be in flash */
+        const boot_record_t *r = (const boot_record_t *)(XIP_BASE + BOOT_TRACE_FLASH_OFFSET);
+        bool saved = (r->magic == BOOT_TRACE_MAGIC);
+
+        for (int i = 0; i < BOOT_NUM_PHASES; i++)
+            t->previous[i] = (saved && (r->done & (1u << i))) ? r->timeline[i] : 0;
+        t->magic = BOOT_TRACE_MAGIC;
+        t->count = saved ? r->count + 1 : 1;
+    }
+
+    for (int i = 0; i < BOOT_NUM_PHASES; i++)
+        t->current[i] = 0;
+    t->done = 0;
+    save_pending = false;
+
+    t->current[BOOT_MAIN] = now;
+    t->done |= 1u << BOOT_MAIN;
+}
+
+void boot_trace_mark(boot_phase_t phase)
+{
+    /* only the first time counts */
+    if (boot_trace_done(phase))
+        return;
+
+    boot_timeline.current[phase] = time_us_32();
+    boot_timeline.done |= 1u << phase;
+}
+
+void boot_trace_save(void)
+{
+    /* written from boot_trace_task(), not from the HTTP request that asked for it */
+    save_pending = true;
+}
+
+void boot_trace_task(void)
+{
+    static uint8_t page[FLASH_PAGE_SIZE];
+    boot_record_t *r = (boot_record_t *)page;
+    uint32_t ints;
+
+    if (!save_pending)
+        return;
+    save_pending = false;
+
+    memset(page, 0xFF, sizeof(page));
+    r->magic = BOOT_TRACE_MAGIC;
+    r->count = boot_timeline.count;
+    r->done = boot_timeline.done;
+    memcpy(r->timeline, boot_timeline.current, sizeof(r->timeline));
+
+    /* nothing may run from flash while it is written; the USB controller NAKs the host meanwhile */
+    ints = save_and_disable_interrupts();
+    flash_range_erase(BOOT_TRACE_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(BOOT_TRACE_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+}
+
+bool boot_trace_done(boot_phase_t phase)
+{
+    return (boot_timeline.done & (1u << phase)) != 0;
+}
+
+uint32_t boot_trace_count(void)
+{
+    return boot_timeline.count;
+}
+
+uint32_t boot_trace_get(boot_phase_t phase, bool previous)
+{
+    return previous ? boot_timeline.previous[phase] : boot_timeline.current[phase];
+}
@@ -0,0 +1,47 @@
+#ifndef _BOOT_TRACE_H_
+#define _BOOT_TRACE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Time from reset to each step of bringing the device up, in microseconds.
+ * The timeline is kept in uninitialized RAM, so after a soft reset (watchdog,
+ * BOOTSEL) the one from the previous boot is still available for comparison.
+ * A power cycle loses it. boot_trace_save() writes the current boot to the
+ * last flash sector, and after a power cycle the previous boot comes from
+ * there instead. Writing stalls the CPU and USB for the sector erase, so it
+ * only happens on request. A phase that was not reached reads as 0.
+ */
+
+typedef enum
+{
+    BOOT_MAIN = 0,          /* main() entered, SDK runtime init done */
+    BOOT_INIT_DONE,         /* all initialisation in main() done */
+    BOOT_USB_ENUMERATED,    /* host configured the device */
+    BOOT_NETIF_UP,          /* host brought up its end of the link */
+    BOOT_DHCP_LEASE,        /* dhserver handed out an address */
+    BOOT_FIRST_HTTP_BYTE,   /* first HTTP response data went to the host */
+    BOOT_NUM_PHASES
+} boot_phase_t;
+
+void boot_trace_init(void);
+void boot_trace_mark(boot_phase_t phase);
+bool boot_trace_done(boot_phase_t phase);
+
+/* keep the current boot in flash; boot_trace_task() does the write from the main loop */
+void boot_trace_save(void);
+void boot_trace_task(void);
+
+uint32_t boot_trace_count(void);
+uint32_t boot_trace_get(boot_phase_t phase, bool previous);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -0,0 +1,263 @@
+#include "capture.h"
+#include "tcp_frame.h"
+
+#include "pico/stdlib.h"
+#include "lwip/mem.h"
+#include "lwip/prot/ethernet.h"
+
+#include <string.h>
+
+#define PCAP_MAGIC          0xA1B2C3D4
+#define PCAP_HDR_LEN        24
+#define PCAP_REC_HDR_LEN    16
+#define LINKTYPE_LINUX_SLL  113
+#define SLL_HDR_LEN         16
+#define SLL_HOST            0
+#define SLL_OUTGOING        4
+
+#define HTTP_PORT           80
+
+struct capture_record
+{
+    uint64_t ts_us;
+    uint16_t orig_len;
+    uint16_t cap_len;
+    uint8_t dir;
+    uint8_t data[CAPTURE_SNAPLEN];
+};
+
+/* state of one /capture.pcap download */
+struct capture_reader
+{
+    uint32_t next;          /* sequence number of the next record to send */
+    uint32_t end;           /* records after this were taken while downloading */
+    uint16_t off;
+    uint16_t len;
+    uint8_t out[PCAP_REC_HDR_LEN + SLL_HDR_LEN + CAPTURE_SNAPLEN];
+};
+
+/* off until /capture_start, so frames cost one branch each by default */
+bool capture_enabled = false;
+
+static struct capture_record ring[CAPTURE_SLOTS];
+
+/*
+ * Sequence number of the next record; the newest is at (capture_seq - 1) % CAPTURE_SLOTS.
+ * It only ever grows, so a download running across capture_start() stays consistent;
+ * capture_start() moves capture_first instead, records before it are gone.
+ */
+static uint32_t capture_seq;
+static uint32_t capture_first;
+
+/* client port of the connection downloading the capture, whose frames are not recorded */
+static uint16_t skip_port;
+
+static bool skip_frame(uint8_t dir, const uint8_t *frame, uint16_t len)
+{
+    uint16_t src, dst;
+
+    if (!tcp_frame_ports(frame, len, &src, &dst, NULL))
+        return false;
+
+    if (dir == CAPTURE_RX)
+        return src == skip_port && dst == HTTP_PORT;
+    else
+        return src == HTTP_PORT && dst == skip_port;
+}
+
+static struct capture_record *next_record(uint8_t dir, uint16_t len)
+{
+    struct capture_record *rec = &ring[capture_seq++ % CAPTURE_SLOTS];
+
+    rec->ts_us = time_us_64();
+    rec->orig_len = len;
+    rec->cap_len = (len < CAPTURE_SNAPLEN) ? len : CAPTURE_SNAPLEN;
+    rec->dir = dir;
+
+    return rec;
+}
+
+void capture_frame(uint8_t dir, const uint8_t *data, uint16_t len)
+{
+    struct capture_record *rec;
+
+    if (skip_port && skip_frame(dir, data, len))
+        return;
+
+    rec = next_record(dir, len);
+    memcpy(rec->data, data, rec->cap_len);
+}
+
+void capture_pbuf(uint8_t dir, struct pbuf *p)
+{
+    struct capture_record *rec;
+
+    /* lwIP puts all headers in the first pbuf of the chain */
+    if (skip_port && skip_frame(dir, (const uint8_t *)p->payload, p->len))
+        return;
+
+    rec = next_record(dir, p->tot_len);
+    pbuf_copy_partial(p, rec->data, rec->cap_len, 0);
+}
+
+void capture_start(void)
+{
+    capture_first = capture_seq;
+    capture_enabled = true;
+}
+
+/* sequence number of the oldest record still in the ring */
+static uint32_t oldest_seq(void)
+{
+    uint32_t oldest = (capture_seq > CAPTURE_SLOTS) ? capture_seq - CAPTURE_SLOTS : 0;
+
+    return LWIP_MAX(oldest, capture_first);
+}
+
+void capture_stop(void)
+{
+    capture_enabled = false;
+}
+
+static void put_u16_be(uint8_t *dst, uint16_t v)
+{
+    dst[0] = v >> 8;
+    dst[1] = v & 0xFF;
+}
+
+static uint16_t put_file_header(uint8_t *dst)
+{
+    const uint32_t magic = PCAP_MAGIC, zero = 0;
+    const uint32_t snaplen = SLL_HDR_LEN + CAPTURE_SNAPLEN, linktype = LINKTYPE_LINUX_SLL;
+    const uint16_t major = 2, minor = 4;
+
+    /* native byte order; readers tell from the magic */
+    memcpy(dst, &magic, 4);
+    memcpy(dst + 4, &major, 2);
+    memcpy(dst + 6, &minor, 2);
+    memcpy(dst + 8, &zero, 4);          /* thiszone */
+    memcpy(dst + 12, &zero, 4);         /* sigfigs */
+    memcpy(dst + 16, &snaplen, 4);
+    memcpy(dst + 20, &linktype, 4);
+
+    return PCAP_HDR_LEN;
+}
+
+/* Ethernet header becomes a cooked header, which has room for the direction */
+static uint16_t put_record(uint8_t *dst, const struct capture_record *rec)
+{
+    uint16_t payload = (rec->cap_len > SIZEOF_ETH_HDR) ? rec->cap_len - SIZEOF_ETH_HDR : 0;
+    uint16_t orig = (rec->orig_len > SIZEOF_ETH_HDR) ? rec->orig_len - SIZEOF_ETH_HDR : 0;
+    uint32_t ts_sec = (uint32_t)(rec->ts_us / 1000000);
+    uint32_t ts_usec = (uint32_t)(rec->ts_us % 1000000);
+    uint32_t incl_len = SLL_HDR_LEN + payload;
+    uint32_t orig_len = SLL_HDR_LEN + orig;
+    uint8_t *sll = dst + PCAP_REC_HDR_LEN;
+
+    memcpy(dst, &ts_sec, 4);
+    memcpy(dst + 4, &ts_usec, 4);
+    memcpy(dst + 8, &incl_len, 4);
+    memcpy(dst + 12, &orig_len, 4);
+
+    memset(sll, 0, SLL_HDR_LEN);
+    put_u16_be(sll, rec->dir == CAPTURE_RX ? SLL_HOST : SLL_OUTGOING);
+    put_u16_be(sll + 2, 1);             /* ARPHRD_ETHER */
+    put_u16_be(sll + 4, ETH_HWADDR_LEN);
+    if (rec->cap_len >= SIZEOF_ETH_HDR)
+    {
+        memcpy(sll + 6, rec->data + ETH_HWADDR_LEN, ETH_HWADDR_LEN);
+        memcpy(sll + 14, rec->data + 12, 2);
+    }
+
+    memcpy(sll + SLL_HDR_LEN, rec->data + SIZEOF_ETH_HDR, payload);
+
+    return PCAP_REC_HDR_LEN + SLL_HDR_LEN + payload;
+}
+
+void capture_open(struct http_stream *s)
+{
+    uint32_t oldest = oldest_seq();
+
+    (void)s;
+
+    /* the ring only moves while capturing, so there is nothing to keep out otherwise */
+    if (!capture_enabled)
+        return;
+
+    /* the request that got us here is the newest frame received */
+    for (uint32_t seq = capture_seq; seq > oldest; seq--)
+    {
+        const struct capture_record *rec = &ring[(seq - 1) % CAPTURE_SLOTS];
+        uint16_t src, dst;
+
+        if (rec->dir != CAPTURE_RX)
+            continue;
+
+        if (tcp_frame_ports(rec->data, rec->cap_len, &src, &dst, NULL) && dst == HTTP_PORT)
+            skip_port = src;
+        break;
+    }
+}
+
+int capture_respond(struct http_stream *s, char *buf, int len)
+{
+    struct capture_reader *r = (struct capture_reader *)s->state;
+    int n = 0;
+
+    if (!r)
+    {
+        r = (struct capture_reader *)mem_malloc(sizeof(*r));
+        /* httpd's poll timer tries again, and gives up on the connection if it never fits */
+        if (!r)
+            return HTTP_STREAM_PENDING;
+
+        r->end = capture_seq;
+        r->next = oldest_seq();
+        r->len = put_file_header(r->out);
+        r->off = 0;
+
+        s->state = r;
+    }
+
+    /* records are copied out one at a time, so the ring can keep going meanwhile */
+    while (n < len)
+    {
+        if (r->off < r->len)
+        {
+            int chunk = LWIP_MIN(len - n, r->len - r->off);
+
+            memcpy(buf + n, r->out + r->off, chunk);
+            r->off += chunk;
+            n += chunk;
+            continue;
+        }
+
+        if (r->next == r->end)
+            break;
+
+        /* overwritten by newer traffic, or cleared by capture_start(), since the download started */
+        if (r->next < oldest_seq())
+        {
+            r->next = LWIP_MIN(oldest_seq(), r->end);
+            continue;
+        }
+
+        r->len = put_record(r->out, &ring[r->next % CAPTURE_SLOTS]);
+        r->off = 0;
+        r->next++;
+    }
+
+    return n ? n : HTTP_STREAM_DONE;
+}
+
+void capture_close(struct http_stream *s)
+{
+    /* the rest of this connection (FIN, last ACKs) shows up in the capture again */
+    skip_port = 0;
+
+    if (s->state)
+    {
+        mem_free(s->state);
+        s->state = NULL;
+    }
+}
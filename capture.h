@@ -0,0 +1,57 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "http_stream.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * On-device packet capture. The last CAPTURE_SLOTS frames in either direction
+ * are kept in a ring, cut to CAPTURE_SNAPLEN bytes, and /capture.pcap streams
+ * them out as a pcap file (Linux cooked capture, so tcpdump and Wireshark show
+ * the direction). Received frames are recorded as they come in, sent ones
+ * when the transmit scheduler hands them to the USB driver, so frames lwIP
+ * could not queue are not in it. The download's own connection is left out
+ * of the capture while it is being served.
+ *
+ * While capture is stopped, the hooks cost one branch each.
+ */
+
+#ifndef CAPTURE_SLOTS
+#define CAPTURE_SLOTS       64
+#endif
+
+#ifndef CAPTURE_SNAPLEN
+#define CAPTURE_SNAPLEN     128
+#endif
+
+#define CAPTURE_RX          0
+#define CAPTURE_TX          1
+
+extern bool capture_enabled;
+
+void capture_frame(uint8_t dir, const uint8_t *data, uint16_t len);
+void capture_pbuf(uint8_t dir, struct pbuf *p);
+
+#define CAPTURE_FRAME(dir, data, len)   do { if (capture_enabled) capture_frame(dir, data, len); } while (0)
+#define CAPTURE_PBUF(dir, p)            do { if (capture_enabled) capture_pbuf(dir, p); } while (0)
+
+/* start clears the ring */
+void capture_start(void);
+void capture_stop(void);
+
+/* http_stream_handler_t callbacks for /capture.pcap */
+void capture_open(struct http_stream *s);
+int capture_respond(struct http_stream *s, char *buf, int len);
+void capture_close(struct http_stream *s);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -10,7 +10,13 @@
 
 class PokemonSaveFile {
     constructor(saveData) {
+        // Accept an ArrayBuffer or a Uint8Array; every read below goes through
+        // views on the same memory, nothing is copied
+        if (saveData instanceof ArrayBuffer) {
+            saveData = new Uint8Array(saveData);
+        }
         this.saveData = saveData;
+        this.view = new DataView(saveData.buffer, saveData.byteOffset, saveData.byteLength);
         
         // Detect the Pokemon game generation
         this.generation = this.detectGeneration();
@@ -53,27 +59,24 @@ class PokemonSaveFile {
         return 0; // Unknown format
     }
     
-    // Get a subset of the save data
+    // Get a view of a subset of the save data (shares memory, no copy)
     getBytes(offset, length) {
-        return this.saveData.slice(offset, offset + length);
+        return this.saveData.subarray(offset, offset + length);
     }
     
     // Read a byte from the save data
     readByte(offset) {
-        return this.saveData[offset];
+        return this.view.getUint8(offset);
     }
     
     // Read a 16-bit word from the save data (little endian)
     readWord(offset) {
-        return this.saveData[offset] + (this.saveData[offset + 1] << 8);
+        return this.view.getUint16(offset, true);
     }
     
     // Read a 32-bit double word from the save data (little endian)
     readDWord(offset) {
-        return this.saveData[offset] + 
-               (this.saveData[offset + 1] << 8) + 
-               (this.saveData[offset + 2] << 16) + 
-               (this.saveData[offset + 3] << 24);
+        return this.view.getUint32(offset, true);
     }
     
     // Convert Game Boy text encoding to ASCII/Unicode for Gen 1
@@ -613,4 +616,17 @@ class PokemonSaveFile {
     getPartyPokemon() {
         return this.partyPokemon;
     }
+    
+    // Plain object with everything the page displays, cheap to post from a worker
+    toResult() {
+        return {
+            generation: this.generation,
+            gameVersion: this.getGameVersion(),
+            trainerName: this.trainerName,
+            money: this.money,
+            badges: this.getBadges(),
+            playTime: this.playTimeFormatted,
+            party: this.partyPokemon
+        };
+    }
 } 
\ No newline at end of file
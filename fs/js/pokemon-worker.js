@@ -0,0 +1,26 @@
+/**
+ * Pokemon Save File Parser worker
+ * Parses a save file off the main thread. The page transfers the file's
+ * ArrayBuffer (no copy) and gets back the compact result of toResult().
+ */
+
+importScripts('/js/pokemon-parser.js');
+
+self.onmessage = function(e) {
+    const start = performance.now();
+    
+    try {
+        const saveFile = new PokemonSaveFile(e.data.buffer);
+        
+        self.postMessage({
+            id: e.data.id,
+            result: saveFile.toResult(),
+            parseTime: performance.now() - start
+        });
+    } catch (error) {
+        self.postMessage({
+            id: e.data.id,
+            error: error.message
+        });
+    }
+};
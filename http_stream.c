@@ -0,0 +1,454 @@
+#include "http_stream.h"
+#include "lwip_hooks.h"
+
+#include "lwip/init.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+
+#include <string.h>
+#include <stdio.h>
+
+enum
+{
+    STREAM_FREE = 0,
+    STREAM_BODY,        /* receiving the POST body */
+    STREAM_POSTED,      /* body done, waiting for httpd to open the response */
+    STREAM_HEADER,
+    STREAM_DATA,
+    STREAM_TRAILER,
+    STREAM_DONE
+};
+
+/* "xxxx\r\n" before and "\r\n" after every chunk */
+#define CHUNK_PREFIX_LEN    6
+#define CHUNK_OVERHEAD      (CHUNK_PREFIX_LEN + 2)
+#define CHUNK_MAX_LEN       0xFFFF
+
+/* lets httpd keep asking for data; the real end is signalled with index = len */
+#define STREAM_FILE_LEN     0x7FFFFFFF
+
+static const char chunk_trailer[] = "0\r\n\r\n";
+
+static const http_stream_handler_t *stream_handlers;
+static int stream_num_handlers;
+
+static struct http_stream streams[HTTP_STREAM_MAX_STREAMS];
+
+/* httpd opens the response file right after httpd_post_finished(), from the same call */
+static struct http_stream *posted_stream;
+
+/*
+ * httpd does not pass the request line on to the fs layer, so the TCP input
+ * hook remembers which connections asked for HTTP/1.0. httpd only calls
+ * httpd_post_begin() and fs_open_custom() from its recv callback, i.e. from
+ * within tcp_input(), so there input_pcb is the connection of the request.
+ * Anywhere else it is stale and must not be used.
+ */
+static const struct tcp_pcb *http10_pcbs[HTTP_STREAM_MAX_STREAMS];
+static int http10_next;
+static const struct tcp_pcb *input_pcb;
+
+void http_stream_set_handlers(const http_stream_handler_t *handlers, int num_handlers)
+{
+    stream_handlers = handlers;
+    stream_num_handlers = num_handlers;
+}
+
+static const http_stream_handler_t *find_handler(const char *uri)
+{
+    for (int i = 0; i < stream_num_handlers; i++)
+    {
+        size_t len = strlen(stream_handlers[i].uri);
+
+        /* ignore any query string */
+        if (!strncmp(uri, stream_handlers[i].uri, len) && (uri[len] == '\0' || uri[len] == '?'))
+            return &stream_handlers[i];
+    }
+
+    return NULL;
+}
+
+static void stream_free(struct http_stream *s)
+{
+    if (s->handler && s->handler->close)
+        s->handler->close(s);
+
+    if (posted_stream == s)
+        posted_stream = NULL;
+
+    memset(s, 0, sizeof(*s));
+}
+
+static struct http_stream *stream_alloc(const http_stream_handler_t *h, void *connection)
+{
+    struct http_stream *s = NULL;
+
+    for (int i = 0; i < HTTP_STREAM_MAX_STREAMS; i++)
+    {
+        /* httpd has no callback for a POST aborted halfway, so take back stale ones here */
+        if (streams[i].phase == STREAM_BODY &&
+            (streams[i].connection == connection ||
+             sys_now() - streams[i].started >= HTTP_STREAM_BODY_TIMEOUT_MS))
+        {
+            stream_free(&streams[i]);
+        }
+
+        if (!s && streams[i].phase == STREAM_FREE)
+            s = &streams[i];
+    }
+
+    if (s)
+    {
+        s->handler = h;
+        s->connection = connection;
+        s->started = sys_now();
+    }
+
+    return s;
+}
+
+static struct http_stream *stream_for_connection(void *connection)
+{
+    for (int i = 0; i < HTTP_STREAM_MAX_STREAMS; i++)
+    {
+        if (streams[i].phase == STREAM_BODY && streams[i].connection == connection)
+            return &streams[i];
+    }
+
+    return NULL;
+}
+
+/* a POST body is still coming in on this connection */
+static int receiving_body(const struct tcp_pcb *pcb)
+{
+    for (int i = 0; i < HTTP_STREAM_MAX_STREAMS; i++)
+    {
+        if (streams[i].phase == STREAM_BODY && streams[i].pcb == pcb &&
+            sys_now() - streams[i].started < HTTP_STREAM_BODY_TIMEOUT_MS)
+            return 1;
+    }
+
+    return 0;
+}
+
+static int find_http10(const struct tcp_pcb *pcb)
+{
+    for (int i = 0; i < HTTP_STREAM_MAX_STREAMS; i++)
+    {
+        if (http10_pcbs[i] == pcb)
+            return i;
+    }
+
+    return -1;
+}
+
+err_t http_stream_tcp_input(const struct tcp_pcb *pcb, const struct pbuf *p)
+{
+    u16_t eol;
+    int slot;
+
+    if (pcb->local_port != HTTPD_SERVER_PORT)
+        return ERR_OK;
+
+    input_pcb = pcb;
+
+    /* a request line starts with the method and ends with " HTTP/1.x"; body segments are not searched */
+    if (p->tot_len < 16 || pbuf_get_at(p, 0) < 'A' || pbuf_get_at(p, 0) > 'Z' || receiving_body(pcb))
+        return ERR_OK;
+
+    eol = pbuf_memfind(p, "\r\n", 2, 0);
+    if (eol == 0xFFFF || eol < 9 || pbuf_memcmp(p, eol - 9, " HTTP/1.", 8))
+        return ERR_OK;
+
+    /* every request on the connection says it again, which also corrects a reused pcb */
+    slot = find_http10(pcb);
+    if (pbuf_get_at(p, eol - 1) == '0')
+    {
+        if (slot < 0)
+        {
+            slot = http10_next;
+            http10_next = (http10_next + 1) % HTTP_STREAM_MAX_STREAMS;
+        }
+        http10_pcbs[slot] = pcb;
+    }
+    else if (slot >= 0)
+    {
+        http10_pcbs[slot] = NULL;
+    }
+
+    return ERR_OK;
+}
+
+void http_stream_resume(struct http_stream *s)
+{
+    fs_wait_cb cb = s->wait_cb;
+
+    if (cb)
+    {
+        s->wait_cb = NULL;
+        cb(s->wait_arg);
+    }
+}
+
+int http_stream_copy(struct http_stream *s, char *buf, int len, const char *src, u32_t src_len)
+{
+    u32_t left;
+
+    if (s->pos >= src_len)
+        return HTTP_STREAM_DONE;
+
+    left = src_len - s->pos;
+    if ((u32_t)len > left)
+        len = (int)left;
+
+    memcpy(buf, src + s->pos, len);
+    s->pos += len;
+
+    return len;
+}
+
+/* copy the part of src not sent yet; returns bytes copied, sets *complete when all of it went out */
+static int copy_partial(struct http_stream *s, char *buf, int count, const char *src, int src_len, int *complete)
+{
+    int n = src_len - s->sent;
+
+    if (n > count)
+        n = count;
+
+    memcpy(buf, src + s->sent, n);
+    s->sent += n;
+    *complete = (s->sent == src_len);
+
+    return n;
+}
+
+static void put_chunk_size(char *dst, int size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for (int i = 3; i >= 0; i--)
+    {
+        dst[i] = hex[size & 0xF];
+        size >>= 4;
+    }
+    dst[4] = '\r';
+    dst[5] = '\n';
+}
+
+/* POST hooks called by httpd */
+
+err_t httpd_post_begin(void *connection, const char *uri, const char *http_request,
+                       u16_t http_request_len, int content_len, char *response_uri,
+                       u16_t response_uri_len, u8_t *post_auto_wnd)
+{
+    const http_stream_handler_t *h = find_handler(uri);
+    struct http_stream *s;
+
+    (void)http_request;
+    (void)http_request_len;
+    (void)response_uri;
+    (void)response_uri_len;
+
+    if (!h)
+        return ERR_VAL;
+
+    s = stream_alloc(h, connection);
+    if (!s)
+        return ERR_MEM;
+
+    s->phase = STREAM_BODY;
+    s->pcb = input_pcb;
+
+    if (h->body_begin && h->body_begin(s, content_len) != ERR_OK)
+    {
+        stream_free(s);
+        return ERR_VAL;
+    }
+
+    *post_auto_wnd = 1;
+    return ERR_OK;
+}
+
+err_t httpd_post_receive_data(void *connection, struct pbuf *p)
+{
+    struct http_stream *s = stream_for_connection(connection);
+    err_t err = ERR_VAL;
+
+    if (s)
+    {
+        s->body_len += p->tot_len;
+        err = s->handler->body_data ? s->handler->body_data(s, p) : ERR_OK;
+    }
+
+    pbuf_free(p);
+    return err;
+}
+
+void httpd_post_finished(void *connection, char *response_uri, u16_t response_uri_len)
+{
+    struct http_stream *s = stream_for_connection(connection);
+
+    if (!s)
+        return;
+
+    if (s->handler->body_end)
+        s->handler->body_end(s);
+
+    s->connection = NULL;
+    s->phase = STREAM_POSTED;
+    posted_stream = s;
+
+    snprintf(response_uri, response_uri_len, "%s", s->handler->uri);
+}
+
+/* custom file hooks called by httpd's fs layer */
+
+int fs_open_custom(struct fs_file *file, const char *name)
+{
+    const http_stream_handler_t *h;
+    struct http_stream *s = posted_stream;
+    /* a POST response opens from the body's last segment, the request line came with the first */
+    const struct tcp_pcb *pcb = s ? s->pcb : input_pcb;
+
+    posted_stream = NULL;
+
+    h = find_handler(name);
+    if (s && s->handler != h)
+    {
+        stream_free(s);
+        s = NULL;
+    }
+
+    if (!h)
+        return 0;
+
+    if (!s)
+    {
+        s = stream_alloc(h, NULL);
+        if (!s)
+            return 0;
+    }
+
+    s->phase = STREAM_HEADER;
+    s->sent = 0;
+    s->pos = 0;
+    s->http10 = (pcb && find_http10(pcb) >= 0);
+
+    if (h->open)
+        h->open(s);
+
+    memset(file, 0, sizeof(*file));
+    file->len = STREAM_FILE_LEN;
+    file->pextension = s;
+    file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+
+    return 1;
+}
+
+void fs_close_custom(struct fs_file *file)
+{
+    struct http_stream *s = (struct http_stream *)file->pextension;
+
+    if (s)
+        stream_free(s);
+
+    file->pextension = NULL;
+}
+
+u8_t fs_canread_custom(struct fs_file *file)
+{
+    /* whether respond() has data is only known by calling it, see fs_read_async_custom() */
+    (void)file;
+    return 1;
+}
+
+u8_t fs_wait_read_custom(struct fs_file *file, fs_wait_cb callback_fn, void *callback_arg)
+{
+    struct http_stream *s = (struct http_stream *)file->pextension;
+
+    s->wait_cb = callback_fn;
+    s->wait_arg = callback_arg;
+    return 1;
+}
+
+int fs_read_async_custom(struct fs_file *file, char *buffer, int count, fs_wait_cb callback_fn, void *callback_arg)
+{
+    struct http_stream *s = (struct http_stream *)file->pextension;
+    char header[160];
+    int header_len, n, room, complete;
+
+    switch (s->phase)
+    {
+    case STREAM_HEADER:
+        /* HTTP/1.0 has no chunked encoding; the body then simply ends when the connection closes */
+        header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Server: lwIP/" LWIP_VERSION_STRING "\r\n"
+                              "Content-Type: %s\r\n"
+                              "%s"
+                              "Connection: close\r\n\r\n",
+                              s->handler->content_type ? s->handler->content_type : "text/plain",
+                              s->http10 ? "" : "Transfer-Encoding: chunked\r\n");
+
+        n = copy_partial(s, buffer, count, header, header_len, &complete);
+        if (complete)
+            s->phase = STREAM_DATA;
+        return n;
+
+    case STREAM_DATA:
+        if (s->http10)
+        {
+            n = s->handler->respond(s, buffer, count);
+            if (n == HTTP_STREAM_PENDING)
+            {
+                s->wait_cb = callback_fn;
+                s->wait_arg = callback_arg;
+                return FS_READ_DELAYED;
+            }
+            if (n > 0)
+                return n;
+
+            s->phase = STREAM_DONE;
+            file->index = file->len;
+            return FS_READ_EOF;
+        }
+
+        room = count - CHUNK_OVERHEAD;
+        if (room <= 0)
+            return 0;
+        if (room > CHUNK_MAX_LEN)
+            room = CHUNK_MAX_LEN;
+
+        n = s->handler->respond(s, buffer + CHUNK_PREFIX_LEN, room);
+        if (n == HTTP_STREAM_PENDING)
+        {
+            s->wait_cb = callback_fn;
+            s->wait_arg = callback_arg;
+            return FS_READ_DELAYED;
+        }
+
+        if (n > 0)
+        {
+            put_chunk_size(buffer, n);
+            buffer[CHUNK_PREFIX_LEN + n] = '\r';
+            buffer[CHUNK_PREFIX_LEN + n + 1] = '\n';
+            return n + CHUNK_OVERHEAD;
+        }
+
+        s->phase = STREAM_TRAILER;
+        s->sent = 0;
+        /* fall through */
+
+    case STREAM_TRAILER:
+        n = copy_partial(s, buffer, count, chunk_trailer, sizeof(chunk_trailer) - 1, &complete);
+        if (complete)
+        {
+            s->phase = STREAM_DONE;
+            file->index = file->len;
+        }
+        return n;
+
+    default:
+        return FS_READ_EOF;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef _HTTP_STREAM_H_
+#define _HTTP_STREAM_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "lwip/apps/httpd.h"
+#include "lwip/apps/fs.h"
+#include "lwip/pbuf.h"
+
+/*
+ * Streaming handlers for httpd, for routes that need more than a tCGI callback.
+ *
+ * A POST body is handed to body_data() one pbuf at a time as it arrives,
+ * nothing is buffered. The response is pulled from respond() whenever the TCP
+ * send buffer has room (httpd retries from its tcp_sent callback) and goes out
+ * with "Transfer-Encoding: chunked", so its length does not need to be known
+ * up front. HTTP/1.0 clients get the body as it is, ended by closing the
+ * connection.
+ *
+ * respond() returns the number of bytes it wrote to buf, HTTP_STREAM_PENDING
+ * if it has nothing right now, or HTTP_STREAM_DONE once the response is
+ * complete. After returning HTTP_STREAM_PENDING the handler must call
+ * http_stream_resume() when it has more data. Without that, httpd's poll
+ * timer calls respond() again every HTTPD_POLL_INTERVAL and closes the
+ * connection after HTTPD_MAX_RETRIES calls that made no progress, which
+ * leaves the client with an incomplete response.
+ */
+
+#define HTTP_STREAM_PENDING     0
+#define HTTP_STREAM_DONE        (-1)
+
+/* number of requests that can be in flight at once */
+#ifndef HTTP_STREAM_MAX_STREAMS
+#define HTTP_STREAM_MAX_STREAMS 4
+#endif
+
+/* a POST whose connection went away is reclaimed after this long */
+#ifndef HTTP_STREAM_BODY_TIMEOUT_MS
+#define HTTP_STREAM_BODY_TIMEOUT_MS 10000
+#endif
+
+struct http_stream;
+struct tcp_pcb;
+
+typedef struct
+{
+    const char *uri;
+    const char *content_type;
+    /* handler specific data, e.g. the page for tmpl_respond() */
+    const void *arg;
+    /* request body; optional, only called for POST */
+    err_t (*body_begin)(struct http_stream *s, int content_len);
+    err_t (*body_data)(struct http_stream *s, struct pbuf *p);
+    void (*body_end)(struct http_stream *s);
+    /* optional, called when the response starts, still from within the request's last frame */
+    void (*open)(struct http_stream *s);
+    /* response body; required */
+    int (*respond)(struct http_stream *s, char *buf, int len);
+    /* optional, called when the stream is released for whatever reason */
+    void (*close)(struct http_stream *s);
+} http_stream_handler_t;
+
+struct http_stream
+{
+    const http_stream_handler_t *handler;
+    void *state;        /* free for the handler to use */
+    u32_t pos;          /* free for the handler to use, e.g. as read cursor */
+    u32_t body_len;     /* request body bytes received so far */
+
+    /* private to http_stream.c */
+    void *connection;
+    const struct tcp_pcb *pcb;  /* while receiving the body */
+    u32_t started;
+    u16_t sent;
+    u8_t phase;
+    u8_t http10;        /* no chunked encoding */
+    fs_wait_cb wait_cb;
+    void *wait_arg;
+};
+
+void http_stream_set_handlers(const http_stream_handler_t *handlers, int num_handlers);
+void http_stream_resume(struct http_stream *s);
+
+/* respond() helper: send src_len bytes of src, continuing from s->pos */
+int http_stream_copy(struct http_stream *s, char *buf, int len, const char *src, u32_t src_len);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
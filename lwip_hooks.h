@@ -0,0 +1,21 @@
+#ifndef _LWIP_HOOKS_H_
+#define _LWIP_HOOKS_H_
+
+/* Included by lwIP's sources through LWIP_HOOK_FILENAME, see lwipopts.h */
+
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+struct tcp_pcb;
+struct pbuf;
+
+err_t http_stream_tcp_input(const struct tcp_pcb *pcb, const struct pbuf *p);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -48,9 +48,21 @@
 #define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
 #define TCP_SND_BUF                     (2 * TCP_MSS)
 
-#define ETHARP_SUPPORT_STATIC_ENTRIES   1
+/* httpd allocates its per-connection state and the send buffer of streamed responses from here */
+#define MEM_SIZE                        (8 * 1024)
+
+/* the P2P fast path in tusb_lwip_glue.c sends unicast to the host without the ARP table */
+#define ETHARP_SUPPORT_STATIC_ENTRIES   0
 
 #define LWIP_HTTPD_CGI                  1
+#define LWIP_HTTPD_SUPPORT_POST         1
+#define LWIP_HTTPD_CUSTOM_FILES         1
+#define LWIP_HTTPD_DYNAMIC_FILE_READ    1
+#define LWIP_HTTPD_FS_ASYNC_READ        1
+
+/* http_stream.c learns from the request line whether to use chunked encoding */
+#define LWIP_HOOK_FILENAME              "lwip_hooks.h"
+#define LWIP_HOOK_TCP_INPACKET_PCB(pcb, hdr, optlen, opt1len, opt2, p) http_stream_tcp_input(pcb, p)
 #ifndef LWIP_HTTPD_SSI
 #define LWIP_HTTPD_SSI                  0
 #define LWIP_HTTPD_SSI_INCLUDE_TAG      0
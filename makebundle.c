@@ -0,0 +1,750 @@
+/*
+ * Minifies the pages, scripts and stylesheets of a copy of fs/ in place before
+ * makefsdata turns it into fsdata.c, and inlines the scripts and stylesheets a
+ * page loads from the device, so the page arrives in a single request.
+ * Built and run for the host by regen-fsdata.sh, like makefsdata.
+ *
+ * usage: makebundle <dir> <file>...
+ *
+ * <file> is relative to <dir>, which is also the root that "/..." URLs are
+ * looked up in. Pages are handled before the files they inline, so inlining
+ * and the "before" numbers use the unminified originals.
+ *
+ * The minifiers only drop comments and whitespace that cannot change meaning:
+ * line breaks in scripts are kept wherever automatic semicolon insertion
+ * could depend on them, and whitespace in page text is collapsed to one
+ * character rather than removed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#define MAX_TEMPLATE_NESTING    16
+#define MAX_RUNTIME_URLS        16
+
+struct buf
+{
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+static void put(struct buf *b, const char *s, size_t len)
+{
+    if (b->len + len + 1 > b->size)
+    {
+        b->size = (b->len + len + 1) * 2;
+        b->data = realloc(b->data, b->size);
+        if (!b->data)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    memcpy(b->data + b->len, s, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+}
+
+static void put_char(struct buf *b, char c)
+{
+    put(b, &c, 1);
+}
+
+static char last_char(const struct buf *b)
+{
+    return b->len ? b->data[b->len - 1] : '\0';
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long size;
+
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(size + 1);
+    if (data && fread(data, 1, size, f) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    if (data)
+    {
+        data[size] = '\0';
+        *len = size;
+    }
+
+    return data;
+}
+
+static int write_file(const char *path, const struct buf *b)
+{
+    FILE *f = fopen(path, "wb");
+    int ok;
+
+    if (!f)
+        return -1;
+
+    ok = fwrite(b->data, 1, b->len, f) == b->len;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+static int ends_with(const char *s, const char *suffix)
+{
+    size_t len = strlen(s), suffix_len = strlen(suffix);
+
+    return len >= suffix_len && !strcasecmp(s + len - suffix_len, suffix);
+}
+
+/* index after the block comment starting at src[i]; src may be part of a larger text */
+static size_t skip_comment(const char *src, size_t len, size_t i)
+{
+    for (i += 2; i + 1 < len; i++)
+    {
+        if (src[i] == '*' && src[i + 1] == '/')
+            return i + 2;
+    }
+
+    return len;
+}
+
+/* JavaScript */
+
+static int is_word(unsigned char c)
+{
+    /* bytes of UTF-8 sequences count too, they can only be part of identifiers or strings */
+    return isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+}
+
+/* whether a '/' at the end of out starts a regular expression rather than a division */
+static int regex_allowed(const struct buf *out)
+{
+    static const char *keywords[] = {
+        "return", "typeof", "instanceof", "case", "do", "else", "in", "of",
+        "new", "delete", "void", "throw", "yield", "await"
+    };
+    size_t end = out->len, start;
+
+    while (end > 0 && isspace((unsigned char)out->data[end - 1]))
+        end--;
+    if (end == 0)
+        return 1;
+
+    if (strchr("(,=:[!&|?{};+-*%<>~^", out->data[end - 1]))
+        return 1;
+
+    for (start = end; start > 0 && is_word(out->data[start - 1]); start--)
+        ;
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+    {
+        if (end - start == strlen(keywords[i]) && !strncmp(out->data + start, keywords[i], end - start))
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * A '/' after ')' or '}' is taken as a division, but "if (x) / +/.test(s)"
+ * starts a regular expression there, and minifying it as code would drop its
+ * spaces. When such a '/' could close again on the same line with whitespace
+ * in between, the text up to the second '/' is copied as it is: kept verbatim,
+ * it is right whether it turns out to be a regular expression or a division.
+ * Returns the index after the second '/', or i when there is nothing to copy.
+ */
+static size_t ambiguous_division(const struct buf *out, const char *src, size_t len, size_t i)
+{
+    size_t end = out->len, j;
+    int in_class = 0, space = 0;
+
+    while (end > 0 && isspace((unsigned char)out->data[end - 1]))
+        end--;
+    if (end == 0 || (out->data[end - 1] != ')' && out->data[end - 1] != '}'))
+        return i;
+
+    for (j = i + 1; j < len && src[j] != '\n'; j++)
+    {
+        /* not across strings, templates or braces, which the caller must see */
+        if (strchr("'\"`{}", src[j]))
+            return i;
+
+        if (src[j] == '\\')
+            j++;
+        else if (src[j] == '[')
+            in_class = 1;
+        else if (src[j] == ']')
+            in_class = 0;
+        else if (src[j] == '/' && !in_class)
+            break;
+        else
+            space |= isspace((unsigned char)src[j]);
+    }
+
+    /* the second '/' must not start a comment either */
+    if (j >= len || src[j] != '/' || !space || (j + 1 < len && (src[j + 1] == '/' || src[j + 1] == '*')))
+        return i;
+
+    return j + 1;
+}
+
+/* copy a string or regular expression literal starting at src[i]; returns the index after it */
+static size_t copy_literal(struct buf *out, const char *src, size_t len, size_t i, char quote)
+{
+    int in_class = 0;
+
+    put_char(out, src[i++]);
+    while (i < len)
+    {
+        char c = src[i++];
+
+        put_char(out, c);
+        if (c == '\\' && i < len)
+            put_char(out, src[i++]);
+        else if (quote == '/' && c == '[')
+            in_class = 1;
+        else if (quote == '/' && c == ']')
+            in_class = 0;
+        else if ((c == quote && !in_class) || (c == '\n' && quote != '`'))
+            break;
+    }
+
+    return i;
+}
+
+/* copy template literal text up to and including the closing '`' or the next "${" */
+static size_t copy_template(struct buf *out, const char *src, size_t len, size_t i, int *entered_expr)
+{
+    *entered_expr = 0;
+
+    while (i < len)
+    {
+        char c = src[i++];
+
+        put_char(out, c);
+        if (c == '\\' && i < len)
+            put_char(out, src[i++]);
+        else if (c == '`')
+            break;
+        else if (c == '$' && i < len && src[i] == '{')
+        {
+            put_char(out, src[i++]);
+            *entered_expr = 1;
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* emit the whitespace that was dropped before next, if it is needed */
+static void put_js_space(struct buf *out, int pending, char next)
+{
+    char prev = last_char(out);
+
+    if (!pending || !prev)
+        return;
+
+    /* a line break may end a statement, except where no statement can end or continue */
+    if (pending == '\n' && !strchr("{;,([", prev) && !strchr("})],.", next))
+    {
+        put_char(out, '\n');
+        return;
+    }
+
+    if ((is_word(prev) && is_word(next)) ||
+        (prev == next && strchr("+-/", prev)) ||
+        (prev == '/' && is_word(next)))
+    {
+        put_char(out, ' ');
+    }
+}
+
+static void minify_js(struct buf *out, const char *src, size_t len)
+{
+    int braces[MAX_TEMPLATE_NESTING];
+    int depth = 0, pending = 0, entered;
+    size_t i = 0, next;
+
+    while (i < len)
+    {
+        char c = src[i];
+
+        if (isspace((unsigned char)c))
+        {
+            if (c == '\n' || !pending)
+                pending = (c == '\n') ? '\n' : ' ';
+            i++;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < len && src[i + 1] == '/')
+        {
+            while (i < len && src[i] != '\n')
+                i++;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < len && src[i + 1] == '*')
+        {
+            i = skip_comment(src, len, i);
+            if (!pending)
+                pending = ' ';
+            continue;
+        }
+
+        put_js_space(out, pending, c);
+        pending = 0;
+
+        if (c == '\'' || c == '"')
+        {
+            i = copy_literal(out, src, len, i, c);
+        }
+        else if (c == '/' && regex_allowed(out))
+        {
+            i = copy_literal(out, src, len, i, '/');
+        }
+        else if (c == '/' && (next = ambiguous_division(out, src, len, i)) != i)
+        {
+            while (i < next)
+                put_char(out, src[i++]);
+        }
+        else if (c == '`' || (c == '}' && depth && braces[depth - 1] == 0))
+        {
+            /* start of a template literal, or back into its text after a ${} */
+            if (c == '}')
+                depth--;
+            put_char(out, c);
+            i = copy_template(out, src, len, i + 1, &entered);
+
+            if (entered)
+            {
+                if (depth == MAX_TEMPLATE_NESTING)
+                {
+                    fprintf(stderr, "template literals nested too deep\n");
+                    exit(1);
+                }
+                braces[depth++] = 0;
+            }
+        }
+        else
+        {
+            if (depth && c == '{')
+                braces[depth - 1]++;
+            else if (depth && c == '}')
+                braces[depth - 1]--;
+
+            put_char(out, c);
+            i++;
+        }
+    }
+}
+
+/* CSS */
+
+static void minify_css(struct buf *out, const char *src, size_t len)
+{
+    int pending = 0;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        char c = src[i];
+
+        if (isspace((unsigned char)c))
+        {
+            pending = 1;
+            i++;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < len && src[i + 1] == '*')
+        {
+            i = skip_comment(src, len, i);
+            pending = 1;
+            continue;
+        }
+
+        /* spaces around '(' and '+' are significant, e.g. in "and (" and calc() */
+        if (pending && last_char(out) && !strchr("{};:,>", last_char(out)) && !strchr("{};,>!", c))
+            put_char(out, ' ');
+        pending = 0;
+
+        if (c == '}' && last_char(out) == ';')
+            out->len--;
+
+        if (c == '\'' || c == '"')
+            i = copy_literal(out, src, len, i, c);
+        else
+            put_char(out, src[i++]);
+    }
+}
+
+/* HTML */
+
+struct page_stats
+{
+    int requests_before;
+    int requests_after;
+    size_t bytes_before;
+    size_t bytes_after;
+    /* scripts the page's own scripts fetch when they run (workers, lazy loads, service worker) */
+    int num_runtime;
+    char runtime_urls[MAX_RUNTIME_URLS][128];
+};
+
+/* note the same-origin .js URLs in string literals of a script; they cannot be inlined */
+static void find_runtime_urls(struct page_stats *stats, const char *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        char quote = src[i];
+        size_t start = i + 1, end, path_len;
+        int known = 0;
+
+        if (quote != '\'' && quote != '"' && quote != '`')
+            continue;
+
+        for (end = start; end < len && src[end] != quote && src[end] != '\n'; end++)
+            ;
+        i = end;
+
+        if (end - start < 4 || src[start] != '/' || src[start + 1] == '/' || end - start >= sizeof(stats->runtime_urls[0]))
+            continue;
+
+        path_len = strcspn(src + start, "?#\'\"`\n");
+        if (path_len > end - start)
+            path_len = end - start;
+        if (path_len < 3 || strncmp(src + start + path_len - 3, ".js", 3))
+            continue;
+
+        for (int j = 0; j < stats->num_runtime; j++)
+            known |= !strncmp(stats->runtime_urls[j], src + start, path_len) && !stats->runtime_urls[j][path_len];
+
+        if (!known && stats->num_runtime < MAX_RUNTIME_URLS)
+        {
+            memcpy(stats->runtime_urls[stats->num_runtime], src + start, path_len);
+            stats->runtime_urls[stats->num_runtime++][path_len] = '\0';
+        }
+    }
+}
+
+static const char *find_nocase(const char *s, const char *end, const char *needle)
+{
+    size_t n = strlen(needle);
+
+    for (; s + n <= end; s++)
+    {
+        if (!strncasecmp(s, needle, n))
+            return s;
+    }
+
+    return NULL;
+}
+
+/* value of attribute name in the tag [tag, end); *attr_start and *attr_end span the whole attribute */
+static int get_attr(const char *tag, const char *end, const char *name, char *value, size_t size,
+                    const char **attr_start, const char **attr_end)
+{
+    size_t n = strlen(name);
+    const char *p = tag;
+
+    while ((p = find_nocase(p + 1, end, name)) != NULL)
+    {
+        const char *v = p + n;
+        const char *v_end;
+        char quote = '\0';
+
+        if (!isspace((unsigned char)p[-1]) || *v != '=')
+            continue;
+
+        v++;
+        if (*v == '"' || *v == '\'')
+            quote = *v++;
+        for (v_end = v; v_end < end && (quote ? *v_end != quote : !isspace((unsigned char)*v_end) && *v_end != '>'); v_end++)
+            ;
+
+        if ((size_t)(v_end - v) >= size)
+            return 0;
+        memcpy(value, v, v_end - v);
+        value[v_end - v] = '\0';
+
+        *attr_start = p - 1;
+        *attr_end = quote ? v_end + 1 : v_end;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the file a same-origin URL refers to, ignoring any query string; NULL for other URLs */
+static char *load_local(const char *dir, const char *url, size_t *len)
+{
+    char path[512];
+
+    if (url[0] != '/' || url[1] == '/')
+        return NULL;
+
+    snprintf(path, sizeof(path), "%s%.*s", dir, (int)strcspn(url, "?#"), url);
+    return read_file(path, len);
+}
+
+/* script text inside a page must not close the <script> element early */
+static void put_script(struct buf *out, const char *src, size_t len)
+{
+    struct buf js = { 0 };
+    const char *p, *end;
+
+    minify_js(&js, src, len);
+
+    p = js.data;
+    end = js.data + js.len;
+    while (p && p < end)
+    {
+        const char *close = find_nocase(p, end, "</script");
+
+        if (!close)
+            close = end;
+        put(out, p, close - p);
+        if (close == end)
+            break;
+        put(out, "<\\/", 3);
+        p = close + 2;
+    }
+
+    free(js.data);
+}
+
+static void minify_html(struct buf *out, const char *dir, const char *src, size_t len, struct page_stats *stats)
+{
+    const char *p = src, *end = src + len;
+
+    while (p < end)
+    {
+        const char *tag_end, *body_end, *attr_start, *attr_end;
+        char value[256];
+        char *data;
+        size_t data_len;
+
+        if (isspace((unsigned char)*p))
+        {
+            /* one whitespace character renders the same as many */
+            int newline = 0;
+
+            for (; p < end && isspace((unsigned char)*p); p++)
+                newline |= (*p == '\n');
+
+            /* also across a removed comment */
+            if (isspace((unsigned char)last_char(out)))
+            {
+                if (newline)
+                    out->data[out->len - 1] = '\n';
+            }
+            else
+            {
+                put_char(out, newline ? '\n' : ' ');
+            }
+            continue;
+        }
+
+        if (*p != '<')
+        {
+            put_char(out, *p++);
+            continue;
+        }
+
+        if (!strncmp(p, "<!--", 4) && strncmp(p, "<!--[if", 7))
+        {
+            const char *close = strstr(p + 4, "-->");
+
+            p = close ? close + 3 : end;
+            continue;
+        }
+
+        tag_end = memchr(p, '>', end - p);
+        tag_end = tag_end ? tag_end + 1 : end;
+
+        if (!strncasecmp(p, "<script", 7))
+        {
+            body_end = find_nocase(tag_end, end, "</script>");
+            if (!body_end)
+                body_end = end;
+
+            if (get_attr(p, tag_end, "src", value, sizeof(value), &attr_start, &attr_end))
+            {
+                data = load_local(dir, value, &data_len);
+                if (data)
+                {
+                    stats->requests_before++;
+                    stats->bytes_before += data_len;
+
+                    /* the tag without its src attribute, then the script itself */
+                    put(out, p, attr_start - p);
+                    put(out, attr_end, tag_end - attr_end);
+                    put_script(out, data, data_len);
+                    put(out, "</script>", 9);
+                    find_runtime_urls(stats, data, data_len);
+                    free(data);
+
+                    p = body_end + (body_end < end ? 9 : 0);
+                    continue;
+                }
+            }
+            else if (!get_attr(p, tag_end, "type", value, sizeof(value), &attr_start, &attr_end) ||
+                     strstr(value, "javascript") || !strcmp(value, "module"))
+            {
+                put(out, p, tag_end - p);
+                put_script(out, tag_end, body_end - tag_end);
+                put(out, "</script>", 9);
+                find_runtime_urls(stats, tag_end, body_end - tag_end);
+
+                p = body_end + (body_end < end ? 9 : 0);
+                continue;
+            }
+
+            /* data blocks and external scripts are left alone */
+            put(out, p, body_end - p);
+            p = body_end;
+            continue;
+        }
+
+        if (!strncasecmp(p, "<style", 6))
+        {
+            body_end = find_nocase(tag_end, end, "</style>");
+            if (!body_end)
+                body_end = end;
+
+            put(out, p, tag_end - p);
+            minify_css(out, tag_end, body_end - tag_end);
+            p = body_end;
+            continue;
+        }
+
+        if (!strncasecmp(p, "<link", 5) &&
+            get_attr(p, tag_end, "rel", value, sizeof(value), &attr_start, &attr_end) &&
+            !strcasecmp(value, "stylesheet") &&
+            get_attr(p, tag_end, "href", value, sizeof(value), &attr_start, &attr_end) &&
+            (data = load_local(dir, value, &data_len)) != NULL)
+        {
+            stats->requests_before++;
+            stats->bytes_before += data_len;
+
+            put(out, "<style>", 7);
+            minify_css(out, data, data_len);
+            put(out, "</style>", 8);
+            free(data);
+
+            p = tag_end;
+            continue;
+        }
+
+        if (!strncasecmp(p, "<pre", 4) || !strncasecmp(p, "<textarea", 9))
+        {
+            const char *close = find_nocase(tag_end, end, p[1] == 'p' || p[1] == 'P' ? "</pre>" : "</textarea>");
+
+            body_end = close ? close : end;
+            put(out, p, body_end - p);
+            p = body_end;
+            continue;
+        }
+
+        put(out, p, tag_end - p);
+        p = tag_end;
+    }
+}
+
+static int bundle_file(const char *dir, const char *name)
+{
+    struct page_stats stats = { .requests_before = 1, .requests_after = 1 };
+    struct buf out = { 0 };
+    char path[512];
+    size_t len;
+    char *data;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    data = read_file(path, &len);
+    if (!data)
+    {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return -1;
+    }
+
+    put(&out, "", 0);
+
+    if (ends_with(name, ".html") || ends_with(name, ".htm"))
+        minify_html(&out, dir, data, len, &stats);
+    else if (ends_with(name, ".js"))
+    {
+        minify_js(&out, data, len);
+        find_runtime_urls(&stats, data, len);
+    }
+    else if (ends_with(name, ".css"))
+        minify_css(&out, data, len);
+    else
+        put(&out, data, len);
+
+    stats.bytes_before += len;
+    stats.bytes_after += out.len;
+
+    ret = write_file(path, &out);
+    if (ret)
+        fprintf(stderr, "%s: cannot write\n", path);
+    else if (stats.requests_before > 1)
+        printf("%s: %d requests, %lu bytes -> %d request, %lu bytes\n", name,
+               stats.requests_before, (unsigned long)stats.bytes_before,
+               stats.requests_after, (unsigned long)stats.bytes_after);
+    else
+        printf("%s: %lu bytes -> %lu bytes\n", name, (unsigned long)stats.bytes_before, (unsigned long)stats.bytes_after);
+
+    /* not part of the numbers above, but still requests to the device */
+    if (!ret && stats.num_runtime)
+    {
+        printf("%s: its scripts may fetch %d more:", name, stats.num_runtime);
+        for (int i = 0; i < stats.num_runtime; i++)
+            printf(" %s", stats.runtime_urls[i]);
+        printf("\n");
+    }
+
+    free(data);
+    free(out.data);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <dir> <file>...\n", argv[0]);
+        return 1;
+    }
+
+    /* pages first, they inline the other files before those are minified */
+    for (int i = 2; i < argc && !ret; i++)
+    {
+        if (ends_with(argv[i], ".html") || ends_with(argv[i], ".htm"))
+            ret = bundle_file(argv[1], argv[i]);
+    }
+
+    for (int i = 2; i < argc && !ret; i++)
+    {
+        if (!ends_with(argv[i], ".html") && !ends_with(argv[i], ".htm"))
+            ret = bundle_file(argv[1], argv[i]);
+    }
+
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Compiles the pages in templates/ into <out>.c and <out>.h for template.c.
+ * Built and run for the host by regen-fsdata.sh, like makefsdata.
+ *
+ * usage: maketemplates <out> <page>...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_SLOTS       64
+#define MAX_PARTS       256
+#define MAX_TEXT_LEN    0xFFFF
+
+static const char *slot_types[] = { "str", "raw", "int", "uint" };
+static const char *slot_enums[] = { "TMPL_STR", "TMPL_RAW", "TMPL_INT", "TMPL_UINT" };
+
+struct part
+{
+    int type;           /* -1 for text, otherwise index into slot_types */
+    int slot;
+    const char *text;
+    size_t len;
+};
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long size;
+
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(size + 1);
+    if (data && fread(data, 1, size, f) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    if (data)
+    {
+        data[size] = '\0';
+        *len = size;
+    }
+
+    return data;
+}
+
+/* "templates/index.html" -> "index_html" */
+static void make_ident(const char *path, char *ident, size_t size)
+{
+    const char *base = strrchr(path, '/');
+    size_t i = 0;
+
+    for (base = base ? base + 1 : path; *base && i < size - 1; base++)
+        ident[i++] = isalnum((unsigned char)*base) ? tolower((unsigned char)*base) : '_';
+    ident[i] = '\0';
+}
+
+static void put_upper(FILE *f, const char *s)
+{
+    for (; *s; s++)
+        fputc(toupper((unsigned char)*s), f);
+}
+
+static void put_literal(FILE *f, const char *text, size_t len)
+{
+    size_t col = 0;
+
+    fputs("\"", f);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = text[i];
+
+        if (c == '\\' || c == '"')
+            fprintf(f, "\\%c", c);
+        else if (c == '\n')
+            fputs("\\n", f);
+        else if (c == '\r')
+            fputs("\\r", f);
+        else if (c == '\t')
+            fputs("\\t", f);
+        else if (c < 0x20 || c >= 0x7F)
+            /* always three octal digits, so a following digit cannot extend the escape */
+            fprintf(f, "\\%03o", c);
+        else
+            fputc(c, f);
+
+        if (c == '\n' || ++col >= 100)
+        {
+            if (i + 1 < len)
+                fputs("\"\n    \"", f);
+            col = 0;
+        }
+    }
+    fputs("\"", f);
+}
+
+static int compile_page(const char *path, FILE *c, FILE *h)
+{
+    struct part parts[MAX_PARTS];
+    char slot_names[MAX_SLOTS][64];
+    int slot_types_of[MAX_SLOTS];
+    int num_parts = 0, num_slots = 0;
+    char ident[128];
+    size_t len;
+    char *data = read_file(path, &len);
+    char *p, *end;
+
+    if (!data)
+    {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return -1;
+    }
+
+    make_ident(path, ident, sizeof(ident));
+    p = data;
+    end = data + len;
+
+    while (p < end)
+    {
+        char *open = strstr(p, "{{");
+        char *close, *colon;
+        int type, slot;
+
+        if (num_parts + 2 > MAX_PARTS)
+        {
+            fprintf(stderr, "%s: too many parts\n", path);
+            return -1;
+        }
+
+        if (!open)
+            open = end;
+
+        if (open > p)
+        {
+            if ((size_t)(open - p) > MAX_TEXT_LEN)
+            {
+                fprintf(stderr, "%s: literal text longer than %d bytes\n", path, MAX_TEXT_LEN);
+                return -1;
+            }
+            parts[num_parts++] = (struct part){ -1, 0, p, (size_t)(open - p) };
+        }
+
+        if (open == end)
+            break;
+
+        close = strstr(open, "}}");
+        colon = memchr(open, ':', close ? (size_t)(close - open) : 0);
+        if (!close || !colon)
+        {
+            fprintf(stderr, "%s: malformed slot at offset %ld\n", path, (long)(open - data));
+            return -1;
+        }
+
+        *colon = '\0';
+        *close = '\0';
+
+        for (type = 0; type < (int)(sizeof(slot_types) / sizeof(slot_types[0])); type++)
+        {
+            if (!strcmp(open + 2, slot_types[type]))
+                break;
+        }
+        if (type == (int)(sizeof(slot_types) / sizeof(slot_types[0])))
+        {
+            fprintf(stderr, "%s: unknown slot type '%s'\n", path, open + 2);
+            return -1;
+        }
+
+        /* a name used more than once refers to the same value */
+        for (slot = 0; slot < num_slots; slot++)
+        {
+            if (!strcmp(slot_names[slot], colon + 1))
+                break;
+        }
+        if (slot == num_slots)
+        {
+            if (num_slots == MAX_SLOTS || strlen(colon + 1) >= sizeof(slot_names[0]))
+            {
+                fprintf(stderr, "%s: too many slots or slot name too long\n", path);
+                return -1;
+            }
+            strcpy(slot_names[num_slots], colon + 1);
+            slot_types_of[num_slots++] = type;
+        }
+        else if (slot_types_of[slot] != type)
+        {
+            fprintf(stderr, "%s: slot '%s' used with different types\n", path, colon + 1);
+            return -1;
+        }
+
+        parts[num_parts++] = (struct part){ type, slot, NULL, 0 };
+        p = close + 2;
+    }
+
+    /* header: slot indices and the page */
+    fprintf(h, "\nenum\n{\n");
+    for (int i = 0; i < num_slots; i++)
+    {
+        fputs("    TMPL_", h);
+        put_upper(h, ident);
+        fputc('_', h);
+        put_upper(h, slot_names[i]);
+        fprintf(h, " = %d,\n", i);
+    }
+    fputs("    TMPL_", h);
+    put_upper(h, ident);
+    fprintf(h, "_NUM_SLOTS = %d\n};\n\n", num_slots);
+    fprintf(h, "extern const tmpl_t tmpl_%s;\n", ident);
+
+    /* source: literal fragments, then the part table */
+    for (int i = 0; i < num_parts; i++)
+    {
+        if (parts[i].type >= 0)
+            continue;
+
+        fprintf(c, "\nstatic const char tmpl_%s_text%d[] =\n    ", ident, i);
+        put_literal(c, parts[i].text, parts[i].len);
+        fputs(";\n", c);
+    }
+
+    fprintf(c, "\nstatic const tmpl_part_t tmpl_%s_parts[] =\n{\n", ident);
+    for (int i = 0; i < num_parts; i++)
+    {
+        if (parts[i].type < 0)
+            fprintf(c, "    { TMPL_TEXT, 0, %u, tmpl_%s_text%d },\n", (unsigned)parts[i].len, ident, i);
+        else
+            fprintf(c, "    { %s, %d, 0, NULL },\n", slot_enums[parts[i].type], parts[i].slot);
+    }
+    fputs("};\n", c);
+
+    fprintf(c, "\nconst tmpl_t tmpl_%s =\n{\n    tmpl_%s_parts,\n    %d,\n    %d\n};\n",
+            ident, ident, num_parts, num_slots);
+
+    printf("%s: %d parts, %d slots\n", path, num_parts, num_slots);
+
+    free(data);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char path[512], guard[128];
+    const char *base;
+    FILE *c, *h;
+    int ret = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <out> <page>...\n", argv[0]);
+        return 1;
+    }
+
+    base = strrchr(argv[1], '/');
+    base = base ? base + 1 : argv[1];
+
+    snprintf(path, sizeof(path), "%s.c", argv[1]);
+    c = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s.h", argv[1]);
+    h = fopen(path, "w");
+    if (!c || !h)
+    {
+        fprintf(stderr, "cannot write %s.c/.h\n", argv[1]);
+        return 1;
+    }
+
+    make_ident(base, guard, sizeof(guard));
+
+    fputs("/* Generated by maketemplates, do not edit */\n\n", c);
+    fprintf(c, "#include \"%s.h\"\n", base);
+
+    fputs("/* Generated by maketemplates, do not edit */\n\n", h);
+    fputs("#ifndef _", h);
+    put_upper(h, guard);
+    fputs("_H_\n#define _", h);
+    put_upper(h, guard);
+    fputs("_H_\n\n#include \"template.h\"\n", h);
+
+    for (int i = 2; i < argc && !ret; i++)
+        ret = compile_page(argv[i], c, h);
+
+    fputs("\n#endif\n", h);
+
+    fclose(c);
+    fclose(h);
+
+    return ret ? 1 : 0;
+}
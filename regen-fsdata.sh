@@ -6,6 +6,41 @@ if [ ! -f makefsdata ]; then
     gcc -o makefsdata -Ilwip/src/include -I. lwip/src/apps/http/makefsdata/makefsdata.c
 fi
 
+if [ ! -f maketemplates ]; then
+    echo Compiling maketemplates
+    gcc -o maketemplates maketemplates.c
+fi
+
+if [ ! -f makebundle ]; then
+    echo Compiling makebundle
+    gcc -o makebundle makebundle.c
+fi
+
+# fs/ holds the sources; what gets flashed is the minified copy in fs_bundle/,
+# with the scripts and stylesheets each page loads inlined into it
+echo Bundling fs/ into fs_bundle/
+rm -rf fs_bundle
+cp -R fs fs_bundle
+rm -f fs_bundle/sw.js
+./makebundle fs_bundle $(cd fs_bundle && find . -type f \( -name '*.html' -o -name '*.js' -o -name '*.css' \) | sed 's|^\./||' | LC_ALL=C sort) || exit 1
+# only pokemon_js.html loads it, and that has it inlined now
+rm -f fs_bundle/js/pokemon-data.js
+
+# The version covers everything flashed, so any change invalidates the browser caches
+echo Generating fs_bundle/sw.js
+version=$(find fs_bundle -type f | LC_ALL=C sort | xargs cat | cksum | cut -d' ' -f1)
+{
+    echo "const MANIFEST = {"
+    echo "    version: '$version',"
+    echo "    precache: ['/pokemon_js.html', '/js/pokemon-parser.js', '/js/pokemon-worker.js']"
+    echo "};"
+    echo
+    cat web/sw.js
+} > fs_bundle/sw.js
+./makebundle fs_bundle sw.js || exit 1
+
 echo Regenerating fsdata.c
-./makefsdata 
+./makefsdata fs_bundle
+echo Regenerating tmpldata.c
+./maketemplates tmpldata templates/* || exit 1
 echo Done
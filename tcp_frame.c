@@ -0,0 +1,37 @@
+#include "tcp_frame.h"
+
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip.h"
+
+#define IP_MIN_HLEN     20
+#define TCP_MIN_HLEN    20
+
+bool tcp_frame_ports(const uint8_t *frame, uint16_t len, uint16_t *src, uint16_t *dst, bool *has_data)
+{
+    const uint8_t *ip = frame + SIZEOF_ETH_HDR;
+    const uint8_t *tcp;
+    uint16_t ip_len, ip_hlen, tcp_hlen;
+
+    if (len < SIZEOF_ETH_HDR + IP_MIN_HLEN + TCP_MIN_HLEN || frame[12] != 0x08 || frame[13] != 0x00)
+        return false;
+
+    if ((ip[0] >> 4) != 4 || ip[9] != IP_PROTO_TCP)
+        return false;
+
+    ip_hlen = (ip[0] & 0x0F) * 4;
+    ip_len = (ip[2] << 8) | ip[3];
+    if (ip_hlen < IP_MIN_HLEN || len < SIZEOF_ETH_HDR + ip_hlen + TCP_MIN_HLEN)
+        return false;
+
+    tcp = ip + ip_hlen;
+    tcp_hlen = (tcp[12] >> 4) * 4;
+    if (tcp_hlen < TCP_MIN_HLEN || ip_len < ip_hlen + tcp_hlen)
+        return false;
+
+    *src = (tcp[0] << 8) | tcp[1];
+    *dst = (tcp[2] << 8) | tcp[3];
+    if (has_data)
+        *has_data = ip_len > ip_hlen + tcp_hlen;
+
+    return true;
+}
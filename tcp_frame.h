@@ -0,0 +1,28 @@
+#ifndef _TCP_FRAME_H_
+#define _TCP_FRAME_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Header parsing for the code that looks at raw Ethernet frames on the USB
+ * link (boot trace, transmit scheduler, capture). Only the first len bytes
+ * of the frame are read; lwIP puts all headers in the first pbuf.
+ */
+
+/*
+ * Ports of an IPv4 TCP frame, and whether it carries TCP payload (has_data
+ * may be NULL). Returns false for anything else, or if the IP or TCP header
+ * is malformed or not entirely within len.
+ */
+bool tcp_frame_ports(const uint8_t *frame, uint16_t len, uint16_t *src, uint16_t *dst, bool *has_data);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+#include "template.h"
+
+#include "lwip/mem.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* copy src from offset on; sets *complete when the rest of it fitted */
+static int copy_from(const char *src, int src_len, int offset, char *buf, int len, int *complete)
+{
+    int n = src_len - offset;
+
+    if (n > len)
+        n = len;
+
+    memcpy(buf, src + offset, n);
+    *complete = (offset + n == src_len);
+
+    return n;
+}
+
+static const char *escape_char(char c)
+{
+    switch (c)
+    {
+    case '&':  return "&amp;";
+    case '<':  return "&lt;";
+    case '>':  return "&gt;";
+    case '"':  return "&quot;";
+    case '\'': return "&#39;";
+    default:   return NULL;
+    }
+}
+
+/* the escaped length is not known up front, so walk the string and skip what was sent before */
+static int copy_escaped(const char *src, int offset, char *buf, int len, int *complete)
+{
+    int pos = 0, n = 0;
+
+    for (; *src; src++)
+    {
+        const char *esc = escape_char(*src);
+        int esc_len = esc ? (int)strlen(esc) : 1;
+
+        for (int i = 0; i < esc_len; i++, pos++)
+        {
+            if (pos < offset)
+                continue;
+
+            if (n == len)
+            {
+                *complete = 0;
+                return n;
+            }
+
+            buf[n++] = esc ? esc[i] : *src;
+        }
+    }
+
+    *complete = 1;
+    return n;
+}
+
+static int render_slot(const tmpl_part_t *part, const tmpl_value_t *value, int offset, char *buf, int len, int *complete)
+{
+    char num[12];
+    int num_len;
+
+    switch (part->type)
+    {
+    case TMPL_STR:
+        return copy_escaped(value->s ? value->s : "", offset, buf, len, complete);
+
+    case TMPL_RAW:
+        return copy_from(value->s ? value->s : "", value->s ? (int)strlen(value->s) : 0, offset, buf, len, complete);
+
+    case TMPL_INT:
+        num_len = snprintf(num, sizeof(num), "%ld", (long)value->i);
+        return copy_from(num, num_len, offset, buf, len, complete);
+
+    case TMPL_UINT:
+        num_len = snprintf(num, sizeof(num), "%lu", (unsigned long)value->u);
+        return copy_from(num, num_len, offset, buf, len, complete);
+
+    default:
+        *complete = 1;
+        return 0;
+    }
+}
+
+int tmpl_render(const tmpl_t *t, const tmpl_value_t *values, u32_t *cursor, char *buf, int len)
+{
+    /* part index in the upper half of the cursor, output offset within that part in the lower */
+    u16_t part = (u16_t)(*cursor >> 16);
+    u16_t offset = (u16_t)(*cursor & 0xFFFF);
+    int total = 0;
+
+    while (part < t->num_parts && total < len)
+    {
+        const tmpl_part_t *p = &t->parts[part];
+        int n, complete;
+
+        if (p->type == TMPL_TEXT)
+            n = copy_from(p->text, p->len, offset, buf + total, len - total, &complete);
+        else
+            n = render_slot(p, &values[p->slot], offset, buf + total, len - total, &complete);
+
+        total += n;
+
+        if (complete)
+        {
+            part++;
+            offset = 0;
+        }
+        else
+        {
+            offset += n;
+        }
+    }
+
+    *cursor = ((u32_t)part << 16) | offset;
+
+    if (!total && part >= t->num_parts)
+        return HTTP_STREAM_DONE;
+
+    return total;
+}
+
+int tmpl_respond(struct http_stream *s, char *buf, int len)
+{
+    const tmpl_page_t *page = (const tmpl_page_t *)s->handler->arg;
+    tmpl_value_t *values = (tmpl_value_t *)s->state;
+
+    /* take the values once, so a page split over several sends is consistent */
+    if (!values)
+    {
+        /* out of heap: httpd's poll timer tries again, and closes the connection if it never works */
+        values = (tmpl_value_t *)mem_malloc(LWIP_MAX(page->tmpl->num_slots, 1) * sizeof(tmpl_value_t));
+        if (!values)
+            return HTTP_STREAM_PENDING;
+
+        memset(values, 0, LWIP_MAX(page->tmpl->num_slots, 1) * sizeof(tmpl_value_t));
+        if (page->fill)
+            page->fill(values);
+
+        s->state = values;
+    }
+
+    return tmpl_render(page->tmpl, values, &s->pos, buf, len);
+}
+
+void tmpl_close(struct http_stream *s)
+{
+    if (s->state)
+    {
+        mem_free(s->state);
+        s->state = NULL;
+    }
+}
+
+/* generated by maketemplates */
+#include "tmpldata.c"
@@ -0,0 +1,74 @@
+#ifndef _TEMPLATE_H_
+#define _TEMPLATE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "http_stream.h"
+
+/*
+ * Pages in templates/ are compiled by maketemplates (see regen-fsdata.sh) into
+ * literal fragments and typed slots, so rendering copies the fragments out of
+ * flash and only formats the slots. A slot is written as {{type:name}} where
+ * type is one of:
+ *
+ *   str   string, HTML escaped
+ *   raw   string, copied as is
+ *   int   signed 32-bit integer
+ *   uint  unsigned 32-bit integer
+ *
+ * The generated tmpldata.h has a tmpl_t per page and a TMPL_<PAGE>_<NAME>
+ * index for each slot.
+ */
+
+typedef enum
+{
+    TMPL_TEXT = 0,
+    TMPL_STR,
+    TMPL_RAW,
+    TMPL_INT,
+    TMPL_UINT
+} tmpl_type_t;
+
+typedef struct
+{
+    u8_t type;
+    u8_t slot;          /* index into the value array, unused for TMPL_TEXT */
+    u16_t len;          /* length of text, unused for slots */
+    const char *text;
+} tmpl_part_t;
+
+typedef struct
+{
+    const tmpl_part_t *parts;
+    u16_t num_parts;
+    u8_t num_slots;
+} tmpl_t;
+
+typedef union
+{
+    const char *s;      /* TMPL_STR, TMPL_RAW; must stay valid until the page is sent */
+    s32_t i;            /* TMPL_INT */
+    u32_t u;            /* TMPL_UINT */
+} tmpl_value_t;
+
+/* pass as http_stream_handler_t.arg, with tmpl_respond and tmpl_close as callbacks */
+typedef struct
+{
+    const tmpl_t *tmpl;
+    /* fills in every slot once, when the page starts rendering */
+    void (*fill)(tmpl_value_t *values);
+} tmpl_page_t;
+
+int tmpl_respond(struct http_stream *s, char *buf, int len);
+void tmpl_close(struct http_stream *s);
+
+/* render from *cursor (0 to start) into buf; returns bytes written or HTTP_STREAM_DONE */
+int tmpl_render(const tmpl_t *t, const tmpl_value_t *values, u32_t *cursor, char *buf, int len);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Times large POST uploads to /upload on a connected board and checks that
+# every byte arrived. Needs the board plugged in and curl on the host.
+#
+# usage: tests/bench-upload.sh [host] [megabytes] [runs]
+
+host=${1:-192.168.7.1}
+mb=${2:-4}
+runs=${3:-3}
+
+file=$(mktemp)
+trap 'rm -f "$file"' EXIT
+
+dd if=/dev/urandom of="$file" bs=1048576 count="$mb" 2>/dev/null
+bytes=$(wc -c < "$file" | tr -d ' ')
+
+echo "Uploading $bytes bytes to http://$host/upload, $runs runs"
+
+for i in $(seq "$runs"); do
+    out=$(curl -s -S -w ' %{time_total} %{speed_upload}' --data-binary @"$file" \
+          -H 'Content-Type: application/octet-stream' "http://$host/upload") || exit 1
+
+    # {"bytes":N} followed by the curl timings
+    got=$(echo "$out" | sed -n 's/.*"bytes":\([0-9]*\).*/\1/p')
+    set -- $(echo "$out" | sed 's/.*}//')
+
+    if [ "$got" != "$bytes" ]; then
+        echo "run $i: board reported $got bytes, sent $bytes"
+        exit 1
+    fi
+
+    echo "run $i: $1 s, $(awk "BEGIN { printf \"%.1f\", $2 / 1024 }") KiB/s"
+done
@@ -0,0 +1,221 @@
+/*
+ * Host benchmark: renders templates/index.html with tmpl_render() and the
+ * same page with SSI tags (<!--#name-->) through a byte-at-a-time tag
+ * scanner, and reports the time per page. Both produce identical output.
+ *
+ * The scanner is an approximation written after httpd's LWIP_HTTPD_SSI state
+ * machine, not lwIP's httpd.c itself, which needs the lwip submodule and a
+ * TCP stub. It leaves out httpd's per-segment bookkeeping and the pbuf work
+ * around each tag, so it probably flatters SSI. Host CPU times, so only the
+ * ratio carries over to the RP2040. Built and run by tests/run-tests.sh.
+ */
+
+#include "template.h"
+#include "tmpldata.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_PAGE    8192
+#define SEND_LEN    1460
+#define ITERATIONS  200000
+
+static const char *led = "on";
+static const u32_t uptime = 123456;
+static const char *board_id = "E6614103E72B";
+
+/* SSI approximation: the per-byte tag scan httpd does on a .shtml file */
+
+static const char *ssi_tags[] = { "led", "uptime", "board_id" };
+
+static const char tag_lead_in[] = "<!--#";
+static const char tag_lead_out[] = "-->";
+
+enum { TAG_NONE, TAG_LEADIN, TAG_FOUND, TAG_LEADOUT };
+
+static int ssi_handler(int index, char *insert, int insert_len)
+{
+    switch (index)
+    {
+    case 0:  return snprintf(insert, insert_len, "%s", led);
+    case 1:  return snprintf(insert, insert_len, "%lu", (unsigned long)uptime);
+    default: return snprintf(insert, insert_len, "%s", board_id);
+    }
+}
+
+/* returns the rendered length; out must hold the whole page */
+static int ssi_render(const char *page, int len, char *out)
+{
+    char tag[32], insert[192];
+    int state = TAG_NONE, index = 0, tag_len = 0, n = 0;
+
+    for (int i = 0; i < len; i++)
+    {
+        char c = page[i];
+
+        switch (state)
+        {
+        case TAG_NONE:
+            if (c == tag_lead_in[0])
+            {
+                state = TAG_LEADIN;
+                index = 1;
+            }
+            else
+            {
+                out[n++] = c;
+            }
+            break;
+
+        case TAG_LEADIN:
+            if (c == tag_lead_in[index])
+            {
+                if (++index == (int)sizeof(tag_lead_in) - 1)
+                {
+                    state = TAG_FOUND;
+                    tag_len = 0;
+                }
+            }
+            else
+            {
+                /* not a tag after all, send what was held back */
+                memcpy(out + n, tag_lead_in, index);
+                n += index;
+                i--;
+                state = TAG_NONE;
+            }
+            break;
+
+        case TAG_FOUND:
+            if (c == ' ' || c == tag_lead_out[0])
+            {
+                tag[tag_len] = '\0';
+                state = TAG_LEADOUT;
+                index = (c == tag_lead_out[0]) ? 1 : 0;
+            }
+            else if (tag_len < (int)sizeof(tag) - 1)
+            {
+                tag[tag_len++] = c;
+            }
+            break;
+
+        case TAG_LEADOUT:
+            if (c == tag_lead_out[index] && ++index == (int)sizeof(tag_lead_out) - 1)
+            {
+                /* httpd looks the tag up by name in the table given to http_set_ssi_handler() */
+                for (int t = 0; t < (int)(sizeof(ssi_tags) / sizeof(ssi_tags[0])); t++)
+                {
+                    if (!strcmp(tag, ssi_tags[t]))
+                    {
+                        int insert_len = ssi_handler(t, insert, sizeof(insert));
+
+                        memcpy(out + n, insert, insert_len);
+                        n += insert_len;
+                        break;
+                    }
+                }
+                state = TAG_NONE;
+            }
+            break;
+        }
+    }
+
+    return n;
+}
+
+/* the page from templates/, and the same page with SSI tags */
+static int load_pages(char *tmpl_page, char *ssi_page, int *ssi_len)
+{
+    FILE *f = fopen("templates/index.html", "rb");
+    int len, n = 0;
+
+    if (!f)
+        return -1;
+
+    len = (int)fread(tmpl_page, 1, MAX_PAGE - 1, f);
+    tmpl_page[len] = '\0';
+    fclose(f);
+
+    for (const char *p = tmpl_page; *p; )
+    {
+        const char *colon, *close;
+
+        if (strncmp(p, "{{", 2) || !(colon = strchr(p, ':')) || !(close = strstr(p, "}}")))
+        {
+            ssi_page[n++] = *p++;
+            continue;
+        }
+
+        n += sprintf(ssi_page + n, "<!--#%.*s-->", (int)(close - colon - 1), colon + 1);
+        p = close + 2;
+    }
+
+    *ssi_len = n;
+    return 0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    static char tmpl_page[MAX_PAGE], ssi_page[MAX_PAGE], tmpl_out[MAX_PAGE], ssi_out[MAX_PAGE];
+    tmpl_value_t values[TMPL_INDEX_HTML_NUM_SLOTS];
+    volatile int sink = 0;
+    int ssi_len, tmpl_len = 0, ssi_out_len, n;
+    double t0, t_tmpl, t_ssi;
+    u32_t cursor = 0;
+
+    if (load_pages(tmpl_page, ssi_page, &ssi_len))
+    {
+        printf("bench_template: run from the top of the repository\n");
+        return 1;
+    }
+
+    values[TMPL_INDEX_HTML_LED].s = led;
+    values[TMPL_INDEX_HTML_UPTIME].u = uptime;
+    values[TMPL_INDEX_HTML_BOARD_ID].s = board_id;
+
+    /* same output from both, or the comparison means nothing */
+    while ((n = tmpl_render(&tmpl_index_html, values, &cursor, tmpl_out + tmpl_len, SEND_LEN)) > 0)
+        tmpl_len += n;
+    ssi_out_len = ssi_render(ssi_page, ssi_len, ssi_out);
+    if (tmpl_len != ssi_out_len || memcmp(tmpl_out, ssi_out, tmpl_len))
+    {
+        printf("bench_template: outputs differ\n");
+        return 1;
+    }
+
+    t0 = now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        char buf[SEND_LEN];
+
+        /* the values are formatted on every render, like the handler does */
+        values[TMPL_INDEX_HTML_UPTIME].u = uptime + (i & 1);
+        cursor = 0;
+        while ((n = tmpl_render(&tmpl_index_html, values, &cursor, buf, sizeof(buf))) > 0)
+            sink += buf[n - 1];
+    }
+    t_tmpl = (now() - t0) / ITERATIONS;
+
+    t0 = now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        n = ssi_render(ssi_page, ssi_len, ssi_out);
+        sink += ssi_out[n - 1];
+    }
+    t_ssi = (now() - t0) / ITERATIONS;
+
+    printf("bench_template: %d byte page, tmpl_render %.0f ns, SSI-like scan (approximation) %.0f ns, %.1fx\n",
+           tmpl_len, t_tmpl * 1e9, t_ssi * 1e9, t_ssi / t_tmpl);
+
+    return 0;
+}
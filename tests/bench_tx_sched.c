@@ -0,0 +1,295 @@
+/*
+ * Host simulation: how long small responses take to get out while bulk
+ * downloads keep the USB link busy, with tx_sched.c and with a plain FIFO
+ * of the same size. Reports the 50th and 99th percentile over many
+ * responses.
+ *
+ * Model, not a measurement: the link sends 1 byte per microsecond, about
+ * what a full-speed USB network link manages. Every connection keeps up to
+ * TCP_SND_BUF (two segments) queued and is ACKed at once. A full queue makes
+ * the connection try again after the next frame went out, as lwIP does.
+ * Bulk downloads never end; small responses of RESPONSE_LEN bytes start at
+ * random intervals on new connections. Built and run by tests/run-tests.sh.
+ */
+
+#include "tx_sched.h"
+#include "capture.h"
+#include "boot_trace.h"
+#include "tusb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HDR_LEN         (14 + 20 + 20)
+#define MSS             1460
+#define WINDOW          2               /* segments in flight, TCP_SND_BUF / TCP_MSS */
+#define RESPONSE_LEN    3000            /* a small page */
+#define MEAN_GAP_US     20000
+#define RESPONSES       20000
+#define MAX_CONNS       (TX_SCHED_MAX_FLOWS - 1)
+
+struct conn
+{
+    u16_t port;
+    int active;
+    int bulk;
+    u32_t remaining;
+    int in_flight;
+    double started;
+};
+
+static struct conn conns[MAX_CONNS];
+static int use_fifo;
+
+/* the frame the driver just took */
+static u16_t sent_port;
+static u16_t sent_len;
+static int link_credit;
+
+bool tud_ready(void)
+{
+    return true;
+}
+
+bool tud_network_can_xmit(void)
+{
+    return link_credit != 0;
+}
+
+void tud_network_xmit(void *ref, uint16_t arg)
+{
+    const u8_t *frame = (const u8_t *)((struct pbuf *)ref)->payload;
+
+    (void)arg;
+    link_credit--;
+    sent_port = (frame[36] << 8) | frame[37];
+    sent_len = ((struct pbuf *)ref)->tot_len;
+}
+
+bool capture_enabled;
+
+void capture_pbuf(uint8_t dir, struct pbuf *p)
+{
+    (void)dir;
+    (void)p;
+}
+
+bool boot_trace_done(boot_phase_t phase)
+{
+    (void)phase;
+    return true;
+}
+
+void boot_trace_mark(boot_phase_t phase)
+{
+    (void)phase;
+}
+
+/* the scheduler this replaced: one FIFO, same number of frames */
+static struct pbuf *fifo[TX_SCHED_MAX_FRAMES];
+static int fifo_head, fifo_len;
+
+static err_t fifo_enqueue(struct pbuf *p)
+{
+    if (fifo_len == TX_SCHED_MAX_FRAMES)
+        return ERR_MEM;
+
+    pbuf_ref(p);
+    fifo[(fifo_head + fifo_len++) % TX_SCHED_MAX_FRAMES] = p;
+    return ERR_OK;
+}
+
+static int fifo_run(void)
+{
+    struct pbuf *p;
+
+    if (!fifo_len)
+        return 0;
+
+    p = fifo[fifo_head];
+    fifo_head = (fifo_head + 1) % TX_SCHED_MAX_FRAMES;
+    fifo_len--;
+
+    tud_network_xmit(p, 0);
+    pbuf_free(p);
+    return 1;
+}
+
+static struct pbuf *tcp_frame(u16_t port, u16_t payload)
+{
+    static u8_t frame[HDR_LEN + MSS];
+    u16_t len = HDR_LEN + payload, ip_len = 20 + 20 + payload;
+
+    memset(frame, 0, HDR_LEN);
+    frame[12] = 0x08;
+    frame[14] = 0x45;
+    frame[16] = ip_len >> 8;
+    frame[17] = ip_len & 0xFF;
+    frame[23] = 6;
+    frame[35] = 80;
+    frame[36] = port >> 8;
+    frame[37] = port & 0xFF;
+    frame[46] = 0x50;
+
+    return pbuf_alloc_chain(frame, &len, 1);
+}
+
+/* what lwIP would queue on every connection right now */
+static void fill(void)
+{
+    for (int i = 0; i < MAX_CONNS; i++)
+    {
+        struct conn *c = &conns[i];
+
+        while (c->active && c->in_flight < WINDOW && c->remaining)
+        {
+            u16_t payload = (u16_t)LWIP_MIN(c->remaining, MSS);
+            struct pbuf *p = tcp_frame(c->port, payload);
+            err_t err = use_fifo ? fifo_enqueue(p) : tx_sched_enqueue(p);
+
+            pbuf_free(p);
+            if (err != ERR_OK)
+                return;
+
+            c->in_flight++;
+            if (!c->bulk)
+                c->remaining -= payload;
+        }
+    }
+}
+
+static int send_one(void)
+{
+    sent_len = 0;
+    link_credit = 1;
+
+    if (use_fifo)
+        fifo_run();
+    else
+        tx_sched_run();
+
+    link_credit = 0;
+    return sent_len;
+}
+
+static u32_t rand_state;
+
+static double next_gap(void)
+{
+    /* exponential, from a fixed sequence so every run sees the same arrivals */
+    rand_state = rand_state * 1103515245u + 12345u;
+    return -MEAN_GAP_US * log(((rand_state >> 8) + 1.0) / 16777217.0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void simulate(int fifo_mode, int bulk, double *p50, double *p99)
+{
+    static double latency[RESPONSES];
+    double now = 0, next_arrival;
+    int done = 0, started = 0;
+    u16_t next_port = 10000;
+
+    use_fifo = fifo_mode;
+    fifo_head = fifo_len = 0;
+    tx_sched_flush();
+    memset(conns, 0, sizeof(conns));
+    rand_state = 1;
+
+    for (int i = 0; i < bulk; i++)
+    {
+        conns[i].port = 1000 + i;
+        conns[i].active = conns[i].bulk = 1;
+        conns[i].remaining = 0xFFFFFFFF;
+    }
+
+    /* let the downloads get past TX_SCHED_SHORT_BYTES first */
+    for (int i = 0; bulk && i < 64; i++)
+    {
+        fill();
+        now += send_one();
+        for (int j = 0; j < bulk; j++)
+            conns[j].in_flight -= (conns[j].port == sent_port && sent_len);
+    }
+
+    next_arrival = now + next_gap();
+
+    while (done < RESPONSES)
+    {
+        int len;
+
+        while (next_arrival <= now && started < RESPONSES)
+        {
+            for (int i = bulk; i < MAX_CONNS; i++)
+            {
+                if (!conns[i].active)
+                {
+                    conns[i].port = next_port++;
+                    conns[i].active = 1;
+                    conns[i].bulk = 0;
+                    conns[i].remaining = RESPONSE_LEN;
+                    conns[i].in_flight = 0;
+                    conns[i].started = next_arrival;
+                    started++;
+                    break;
+                }
+            }
+            next_arrival += next_gap();
+        }
+
+        fill();
+        len = send_one();
+        if (!len)
+        {
+            /* idle link */
+            now = next_arrival;
+            continue;
+        }
+        now += len;
+
+        for (int i = 0; i < MAX_CONNS; i++)
+        {
+            struct conn *c = &conns[i];
+
+            if (!c->active || c->port != sent_port)
+                continue;
+
+            c->in_flight--;
+            if (!c->bulk && !c->remaining && !c->in_flight)
+            {
+                latency[done++] = now - c->started;
+                c->active = 0;
+            }
+            break;
+        }
+    }
+
+    qsort(latency, RESPONSES, sizeof(latency[0]), cmp_double);
+    *p50 = latency[RESPONSES / 2];
+    *p99 = latency[RESPONSES * 99 / 100];
+}
+
+int main(void)
+{
+    printf("bench_tx_sched: %d byte responses while bulk downloads run, simulated link\n", RESPONSE_LEN);
+
+    for (int bulk = 0; bulk <= 3; bulk++)
+    {
+        double fifo_p50, fifo_p99, sched_p50, sched_p99;
+
+        simulate(1, bulk, &fifo_p50, &fifo_p99);
+        simulate(0, bulk, &sched_p50, &sched_p99);
+
+        printf("bench_tx_sched: %d downloads: FIFO p50 %.1f ms p99 %.1f ms, tx_sched p50 %.1f ms p99 %.1f ms\n",
+               bulk, fifo_p50 / 1000, fifo_p99 / 1000, sched_p50 / 1000, sched_p99 / 1000);
+    }
+
+    return 0;
+}
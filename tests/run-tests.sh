@@ -0,0 +1,36 @@
+#!/bin/sh
+# Host tests for the parts of the firmware that do not need the hardware.
+# Run from the top of the repository: tests/run-tests.sh
+
+set -e
+
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+CFLAGS="-Wall -Wextra -O2 -g -Itests/stubs -I. -I$out"
+
+echo Building test_http_stream
+gcc $CFLAGS -o "$out/test_http_stream" tests/test_http_stream.c http_stream.c tests/stubs/stubs.c
+"$out/test_http_stream"
+
+echo Building test_tx_sched
+gcc $CFLAGS -o "$out/test_tx_sched" tests/test_tx_sched.c tx_sched.c tcp_frame.c tests/stubs/stubs.c
+"$out/test_tx_sched"
+
+echo Building bench_tx_sched
+gcc $CFLAGS -o "$out/bench_tx_sched" tests/bench_tx_sched.c tx_sched.c tcp_frame.c tests/stubs/stubs.c -lm
+"$out/bench_tx_sched"
+
+echo Building test_capture
+gcc $CFLAGS -o "$out/test_capture" tests/test_capture.c capture.c tcp_frame.c tests/stubs/stubs.c
+"$out/test_capture"
+
+echo Building test_template
+gcc -o "$out/maketemplates" maketemplates.c
+"$out/maketemplates" "$out/tmpldata" templates/* > /dev/null
+gcc $CFLAGS -o "$out/test_template" tests/test_template.c template.c tests/stubs/stubs.c
+"$out/test_template"
+
+echo Building bench_template
+gcc $CFLAGS -o "$out/bench_template" tests/bench_template.c template.c tests/stubs/stubs.c
+"$out/bench_template"
@@ -0,0 +1,25 @@
+#ifndef _STUB_LWIP_FS_H_
+#define _STUB_LWIP_FS_H_
+
+#include "lwip/err.h"
+
+#define FS_READ_EOF                     -1
+#define FS_READ_DELAYED                 -2
+#define FS_FILE_FLAGS_HEADER_INCLUDED   0x01
+
+struct fs_file
+{
+    const char *data;
+    int len;
+    int index;
+    void *pextension;
+    u8_t flags;
+};
+
+typedef void (*fs_wait_cb)(void *arg);
+
+int fs_open_custom(struct fs_file *file, const char *name);
+void fs_close_custom(struct fs_file *file);
+int fs_read_async_custom(struct fs_file *file, char *buffer, int count, fs_wait_cb callback_fn, void *callback_arg);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _STUB_LWIP_HTTPD_H_
+#define _STUB_LWIP_HTTPD_H_
+
+#include "lwip/pbuf.h"
+
+#define HTTPD_SERVER_PORT   80
+
+err_t httpd_post_begin(void *connection, const char *uri, const char *http_request,
+                       u16_t http_request_len, int content_len, char *response_uri,
+                       u16_t response_uri_len, u8_t *post_auto_wnd);
+err_t httpd_post_receive_data(void *connection, struct pbuf *p);
+void httpd_post_finished(void *connection, char *response_uri, u16_t response_uri_len);
+
+#endif
@@ -0,0 +1,21 @@
+/* Just enough of lwIP to build the handlers for the host tests */
+
+#ifndef _STUB_LWIP_ARCH_H_
+#define _STUB_LWIP_ARCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t u8_t;
+typedef int8_t s8_t;
+typedef uint16_t u16_t;
+typedef int16_t s16_t;
+typedef uint32_t u32_t;
+typedef int32_t s32_t;
+
+#define LWIP_ARRAYSIZE(x)   (sizeof(x) / sizeof((x)[0]))
+#define LWIP_UNUSED_ARG(x)  (void)(x)
+#define LWIP_MIN(a, b)      ((a) < (b) ? (a) : (b))
+#define LWIP_MAX(a, b)      ((a) > (b) ? (a) : (b))
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _STUB_LWIP_ERR_H_
+#define _STUB_LWIP_ERR_H_
+
+#include "lwip/arch.h"
+
+typedef s8_t err_t;
+
+#define ERR_OK      0
+#define ERR_MEM     -1
+#define ERR_BUF     -2
+#define ERR_VAL     -6
+#define ERR_USE     -8
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _STUB_LWIP_INIT_H_
+#define _STUB_LWIP_INIT_H_
+
+#define LWIP_VERSION_STRING "2.1.3"
+
+#endif
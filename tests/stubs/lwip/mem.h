@@ -0,0 +1,12 @@
+#ifndef _STUB_LWIP_MEM_H_
+#define _STUB_LWIP_MEM_H_
+
+#include "lwip/arch.h"
+
+void *mem_malloc(size_t size);
+void mem_free(void *mem);
+
+/* makes the next mem_malloc() calls fail */
+extern int mem_fail_count;
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _STUB_LWIP_PBUF_H_
+#define _STUB_LWIP_PBUF_H_
+
+#include "lwip/err.h"
+
+struct pbuf
+{
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+    u8_t ref;
+};
+
+/* implemented in stubs.c, on malloc */
+struct pbuf *pbuf_alloc_chain(const void *data, const u16_t *lens, int num);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_ref(struct pbuf *p);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+u8_t pbuf_get_at(const struct pbuf *p, u16_t offset);
+u16_t pbuf_memcmp(const struct pbuf *p, u16_t offset, const void *s2, u16_t n);
+u16_t pbuf_memfind(const struct pbuf *p, const void *mem, u16_t mem_len, u16_t start_offset);
+
+#endif
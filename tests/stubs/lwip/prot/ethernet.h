@@ -0,0 +1,7 @@
+#ifndef _STUB_LWIP_PROT_ETHERNET_H_
+#define _STUB_LWIP_PROT_ETHERNET_H_
+
+#define ETH_HWADDR_LEN      6
+#define SIZEOF_ETH_HDR      14
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _STUB_LWIP_PROT_IP_H_
+#define _STUB_LWIP_PROT_IP_H_
+
+#define IP_PROTO_TCP        6
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _STUB_LWIP_SYS_H_
+#define _STUB_LWIP_SYS_H_
+
+#include "lwip/arch.h"
+
+u32_t sys_now(void);
+
+#endif
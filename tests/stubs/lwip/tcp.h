@@ -0,0 +1,11 @@
+#ifndef _STUB_LWIP_TCP_H_
+#define _STUB_LWIP_TCP_H_
+
+#include "lwip/pbuf.h"
+
+struct tcp_pcb
+{
+    u16_t local_port;
+};
+
+#endif
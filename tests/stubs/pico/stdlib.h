@@ -0,0 +1,10 @@
+/* The pico-sdk calls capture.c makes */
+
+#ifndef _STUB_PICO_STDLIB_H_
+#define _STUB_PICO_STDLIB_H_
+
+#include <stdint.h>
+
+uint64_t time_us_64(void);
+
+#endif
@@ -0,0 +1,141 @@
+/* Host implementations of the few lwIP and pico-sdk functions the tested code calls */
+
+#include "lwip/pbuf.h"
+#include "lwip/mem.h"
+#include "lwip/sys.h"
+#include "pico/stdlib.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int mem_fail_count;
+
+void *mem_malloc(size_t size)
+{
+    if (mem_fail_count > 0)
+    {
+        mem_fail_count--;
+        return NULL;
+    }
+
+    return malloc(size);
+}
+
+void mem_free(void *mem)
+{
+    free(mem);
+}
+
+u32_t sys_now(void)
+{
+    return 0;
+}
+
+uint64_t time_us_64(void)
+{
+    return 0;
+}
+
+struct pbuf *pbuf_alloc_chain(const void *data, const u16_t *lens, int num)
+{
+    struct pbuf *head = NULL, **tail = &head;
+    const char *src = data;
+    u16_t tot_len = 0;
+
+    for (int i = 0; i < num; i++)
+        tot_len += lens[i];
+
+    for (int i = 0; i < num; i++)
+    {
+        struct pbuf *p = malloc(sizeof(*p) + lens[i]);
+
+        p->next = NULL;
+        p->payload = p + 1;
+        p->len = lens[i];
+        p->tot_len = tot_len;
+        p->ref = 1;
+        memcpy(p->payload, src, lens[i]);
+
+        src += lens[i];
+        tot_len -= lens[i];
+        *tail = p;
+        tail = &p->next;
+    }
+
+    return head;
+}
+
+/* like lwIP: frees each pbuf of the chain whose last reference this was */
+u8_t pbuf_free(struct pbuf *p)
+{
+    u8_t n = 0;
+
+    while (p && --p->ref == 0)
+    {
+        struct pbuf *next = p->next;
+
+        free(p);
+        p = next;
+        n++;
+    }
+
+    return n;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+    p->ref++;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+    u16_t copied = 0;
+
+    for (; p && copied < len; p = p->next)
+    {
+        u16_t n;
+
+        if (offset >= p->len)
+        {
+            offset -= p->len;
+            continue;
+        }
+
+        n = LWIP_MIN(p->len - offset, len - copied);
+        memcpy((char *)dataptr + copied, (const char *)p->payload + offset, n);
+        copied += n;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+u8_t pbuf_get_at(const struct pbuf *p, u16_t offset)
+{
+    u8_t c = 0;
+
+    pbuf_copy_partial(p, &c, 1, offset);
+    return c;
+}
+
+u16_t pbuf_memcmp(const struct pbuf *p, u16_t offset, const void *s2, u16_t n)
+{
+    for (u16_t i = 0; i < n; i++)
+    {
+        if (offset + i >= p->tot_len || pbuf_get_at(p, offset + i) != ((const u8_t *)s2)[i])
+            return i + 1;
+    }
+
+    return 0;
+}
+
+u16_t pbuf_memfind(const struct pbuf *p, const void *mem, u16_t mem_len, u16_t start_offset)
+{
+    for (u32_t i = start_offset; i + mem_len <= p->tot_len; i++)
+    {
+        if (!pbuf_memcmp(p, i, mem, mem_len))
+            return i;
+    }
+
+    return 0xFFFF;
+}
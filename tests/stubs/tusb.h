@@ -0,0 +1,13 @@
+/* The TinyUSB calls tx_sched.c makes; each test implements them */
+
+#ifndef _STUB_TUSB_H_
+#define _STUB_TUSB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool tud_ready(void);
+bool tud_network_can_xmit(void);
+void tud_network_xmit(void *ref, uint16_t arg);
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Host test for capture.c: records frames, downloads them through the
+ * /capture.pcap callbacks and checks which records the pcap file holds.
+ * Built and run by tests/run-tests.sh.
+ */
+
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_LEN       60
+#define PCAP_HDR_LEN    24
+/* pcap record header, cooked header, frame without its Ethernet header */
+#define RECORD_LEN      (16 + 16 + FRAME_LEN - 14)
+#define MAX_IDS         256
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static const http_stream_handler_t handler = {
+    .uri = "/capture.pcap",
+    .open = capture_open,
+    .respond = capture_respond,
+    .close = capture_close
+};
+
+/* an IPv4 frame that is not TCP, tagged with id in its first payload byte */
+static void record(int id)
+{
+    u8_t frame[FRAME_LEN] = { [12] = 0x08, [14] = 0x45, [23] = 17 };
+
+    frame[14 + 20] = (u8_t)id;
+    capture_frame(CAPTURE_RX, frame, sizeof(frame));
+}
+
+struct download
+{
+    struct http_stream s;
+    int ids[MAX_IDS];
+    int num_ids;
+    int done;
+};
+
+static void download_open(struct download *d)
+{
+    u8_t header[PCAP_HDR_LEN];
+
+    memset(d, 0, sizeof(*d));
+    d->s.handler = &handler;
+    capture_open(&d->s);
+
+    CHECK(capture_respond(&d->s, (char *)header, sizeof(header)) == PCAP_HDR_LEN, "no file header");
+}
+
+/* read up to n records, one per call, like httpd with a buffer that fits one */
+static void download_read(struct download *d, int n)
+{
+    for (int i = 0; i < n && !d->done; i++)
+    {
+        u8_t rec[RECORD_LEN];
+        int len = capture_respond(&d->s, (char *)rec, sizeof(rec));
+
+        if (len == HTTP_STREAM_DONE)
+        {
+            d->done = 1;
+            break;
+        }
+
+        CHECK(len == RECORD_LEN, "record of %d bytes", len);
+        if (len == RECORD_LEN && d->num_ids < MAX_IDS)
+            d->ids[d->num_ids++] = rec[16 + 16 + 20];
+    }
+}
+
+static void download_close(struct download *d)
+{
+    capture_close(&d->s);
+}
+
+static int ids_are(const struct download *d, int first, int last)
+{
+    if (d->num_ids != last - first + 1)
+        return 0;
+
+    for (int i = 0; i < d->num_ids; i++)
+    {
+        if (d->ids[i] != first + i)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void test_off_at_boot(void)
+{
+    struct download d;
+
+    CHECK(!capture_enabled, "capture is on at boot");
+
+    download_open(&d);
+    download_read(&d, 1);
+    CHECK(d.done && d.num_ids == 0, "records before capture was started");
+    download_close(&d);
+}
+
+static void test_restart_while_downloading(void)
+{
+    struct download d;
+
+    capture_start();
+    for (int id = 1; id <= 10; id++)
+        record(id);
+
+    download_open(&d);
+    download_read(&d, 3);
+
+    /* clears what the download has not read yet, but must not confuse it */
+    capture_start();
+    for (int id = 11; id <= 15; id++)
+        record(id);
+
+    download_read(&d, MAX_IDS);
+    CHECK(d.done, "download did not end");
+    CHECK(ids_are(&d, 1, 3), "download across capture_start() got %d records", d.num_ids);
+    download_close(&d);
+
+    download_open(&d);
+    download_read(&d, MAX_IDS);
+    CHECK(d.done && ids_are(&d, 11, 15), "download after capture_start() got %d records", d.num_ids);
+    download_close(&d);
+}
+
+static void test_overwritten_while_downloading(void)
+{
+    struct download d;
+
+    capture_start();
+    for (int id = 1; id <= 10; id++)
+        record(id);
+
+    download_open(&d);
+    download_read(&d, 2);
+
+    /* the rest of what the download started with is overwritten */
+    for (int id = 11; id <= 10 + CAPTURE_SLOTS; id++)
+        record(id);
+
+    download_read(&d, MAX_IDS);
+    CHECK(d.done && ids_are(&d, 1, 2), "download across a full ring got %d records", d.num_ids);
+    download_close(&d);
+
+    download_open(&d);
+    download_read(&d, MAX_IDS);
+    CHECK(d.done && ids_are(&d, 11, 10 + CAPTURE_SLOTS), "download of a full ring got %d records", d.num_ids);
+    download_close(&d);
+}
+
+int main(void)
+{
+    test_off_at_boot();
+    test_restart_while_downloading();
+    test_overwritten_while_downloading();
+
+    printf("test_capture: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Host test for http_stream.c: drives the httpd POST hooks and the custom
+ * file hooks the way httpd does, and checks what would go on the wire.
+ * Built and run by tests/run-tests.sh.
+ */
+
+#include "http_stream.h"
+#include "lwip_hooks.h"
+#include "lwip/tcp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BODY_LEN        300
+#define BIG_LEN         0x20000
+#define MAX_RESPONSE    (BIG_LEN + 4096)
+
+/* private to http_stream.c, repeated here to test around it */
+#define CHUNK_OVERHEAD  8
+#define CHUNK_MAX_LEN   0xFFFF
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static char body[BODY_LEN];
+static char received[BODY_LEN];
+static int received_len;
+static u32_t body_len_at_end;
+
+static err_t echo_body_begin(struct http_stream *s, int content_len)
+{
+    (void)s;
+    (void)content_len;
+    received_len = 0;
+    return ERR_OK;
+}
+
+static err_t echo_body_data(struct http_stream *s, struct pbuf *p)
+{
+    (void)s;
+
+    if (received_len + p->tot_len > BODY_LEN)
+        return ERR_VAL;
+
+    received_len += pbuf_copy_partial(p, received + received_len, p->tot_len, 0);
+    return ERR_OK;
+}
+
+static void echo_body_end(struct http_stream *s)
+{
+    body_len_at_end = s->body_len;
+}
+
+static int echo_respond(struct http_stream *s, char *buf, int len)
+{
+    return http_stream_copy(s, buf, len, received, received_len);
+}
+
+static int big_respond(struct http_stream *s, char *buf, int len)
+{
+    if (s->pos >= BIG_LEN)
+        return HTTP_STREAM_DONE;
+
+    if ((u32_t)len > BIG_LEN - s->pos)
+        len = BIG_LEN - s->pos;
+
+    for (int i = 0; i < len; i++)
+        buf[i] = (char)('a' + (s->pos + i) % 26);
+    s->pos += len;
+
+    return len;
+}
+
+static const http_stream_handler_t handlers[] = {
+    {
+        .uri = "/echo",
+        .content_type = "application/octet-stream",
+        .body_begin = echo_body_begin,
+        .body_data = echo_body_data,
+        .body_end = echo_body_end,
+        .respond = echo_respond
+    },
+    {
+        .uri = "/big",
+        .respond = big_respond
+    }
+};
+
+static char response[MAX_RESPONSE];
+
+/* read the whole response with reads of count bytes, like httpd's send loop; returns its length */
+static int read_response(struct fs_file *file, int count)
+{
+    static char buf[BIG_LEN];
+    int len = 0;
+
+    for (;;)
+    {
+        int n;
+
+        memset(buf, 0x55, count + 1);
+        n = fs_read_async_custom(file, buf, count, NULL, NULL);
+
+        if (n == FS_READ_EOF)
+            break;
+
+        CHECK(n >= 0 && n <= count, "count %d: read returned %d", count, n);
+        CHECK(buf[count] == 0x55, "count %d: wrote past the buffer", count);
+        if (n < 0 || n > count)
+            return -1;
+
+        if (n == 0)
+        {
+            /* no room for the chunk framing; httpd's buffers are never this small, but it must not stall */
+            CHECK(count <= CHUNK_OVERHEAD, "count %d: no progress", count);
+            n = fs_read_async_custom(file, buf, CHUNK_OVERHEAD + 1, NULL, NULL);
+            CHECK(n > 0, "count %d: no progress with a larger buffer", count);
+            if (n <= 0)
+                return -1;
+        }
+
+        if (len + n >= MAX_RESPONSE)
+            return -1;
+        memcpy(response + len, buf, n);
+        len += n;
+
+        if (file->index == file->len)
+            break;
+    }
+
+    CHECK(fs_read_async_custom(file, buf, count, NULL, NULL) == FS_READ_EOF,
+          "count %d: read after the end", count);
+
+    response[len] = '\0';
+    return len;
+}
+
+/* check headers and chunk framing, and undo it; returns the body length or -1 */
+static int decode_chunked(const char *data, int len, char *out, int count)
+{
+    const char *end = data + len;
+    const char *p = strstr(data, "\r\n\r\n");
+    int out_len = 0;
+
+    CHECK(!strncmp(data, "HTTP/1.1 200 OK\r\n", 17), "count %d: status line", count);
+    CHECK(p && strstr(data, "Transfer-Encoding: chunked\r\n") < p, "count %d: no chunked header", count);
+    if (!p)
+        return -1;
+
+    for (p += 4; p < end; )
+    {
+        char *hex_end;
+        long size = strtol(p, &hex_end, 16);
+
+        CHECK(hex_end == p + 4 || size == 0, "count %d: chunk size is not 4 hex digits", count);
+        CHECK(size <= CHUNK_MAX_LEN && size <= count - CHUNK_OVERHEAD, "count %d: chunk of %ld", count, size);
+        if (strncmp(hex_end, "\r\n", 2) || hex_end + 2 + size + 2 > end)
+        {
+            CHECK(0, "count %d: truncated chunk", count);
+            return -1;
+        }
+
+        if (size == 0)
+        {
+            CHECK(hex_end + 4 == end && !strncmp(hex_end, "\r\n\r\n", 4), "count %d: trailer", count);
+            return out_len;
+        }
+
+        memcpy(out + out_len, hex_end + 2, size);
+        out_len += size;
+        p = hex_end + 2 + size;
+        CHECK(!strncmp(p, "\r\n", 2), "count %d: chunk not followed by CRLF", count);
+        p += 2;
+    }
+
+    CHECK(0, "count %d: no trailer", count);
+    return -1;
+}
+
+/* POST the body to /echo in the given pieces and check what arrived */
+static void post_body(const u16_t *lens, int num, const char *what)
+{
+    char response_uri[64] = "";
+    u8_t auto_wnd = 0;
+    int connection;
+    int off = 0;
+
+    CHECK(httpd_post_begin(&connection, "/echo", "", 0, BODY_LEN, response_uri, sizeof(response_uri), &auto_wnd) == ERR_OK,
+          "%s: post_begin", what);
+
+    for (int i = 0; i < num; i++)
+    {
+        /* lwIP hands over chains, so make each piece two pbufs where it can */
+        u16_t segs[2] = { (u16_t)(lens[i] / 2), (u16_t)(lens[i] - lens[i] / 2) };
+        struct pbuf *p = segs[0] ? pbuf_alloc_chain(body + off, segs, 2) : pbuf_alloc_chain(body + off, &lens[i], 1);
+
+        CHECK(httpd_post_receive_data(&connection, p) == ERR_OK, "%s: receive_data", what);
+        off += lens[i];
+    }
+
+    httpd_post_finished(&connection, response_uri, sizeof(response_uri));
+
+    CHECK(!strcmp(response_uri, "/echo"), "%s: response uri '%s'", what, response_uri);
+    CHECK(body_len_at_end == BODY_LEN, "%s: body_len %lu", what, (unsigned long)body_len_at_end);
+    CHECK(received_len == BODY_LEN && !memcmp(received, body, BODY_LEN), "%s: body differs", what);
+}
+
+static void test_post_splits(void)
+{
+    static u16_t lens[BODY_LEN];
+    char what[64];
+
+    /* one split at every byte boundary */
+    for (int split = 0; split <= BODY_LEN; split++)
+    {
+        struct fs_file file;
+        int num = 0;
+
+        if (split > 0)
+            lens[num++] = split;
+        if (split < BODY_LEN)
+            lens[num++] = BODY_LEN - split;
+
+        snprintf(what, sizeof(what), "split at %d", split);
+        post_body(lens, num, what);
+
+        CHECK(fs_open_custom(&file, "/echo"), "%s: open", what);
+        fs_close_custom(&file);
+    }
+
+    /* a body chopped into pieces of every size */
+    for (int piece = 1; piece <= BODY_LEN; piece++)
+    {
+        struct fs_file file;
+        int num = 0;
+
+        for (int off = 0; off < BODY_LEN; off += piece)
+            lens[num++] = (u16_t)LWIP_MIN(piece, BODY_LEN - off);
+
+        snprintf(what, sizeof(what), "pieces of %d", piece);
+        post_body(lens, num, what);
+
+        CHECK(fs_open_custom(&file, "/echo"), "%s: open", what);
+        fs_close_custom(&file);
+    }
+}
+
+static void test_echo_framing(void)
+{
+    static const u16_t whole[] = { BODY_LEN };
+    static char decoded[MAX_RESPONSE];
+
+    /* read sizes around the framing overhead and the header length, and a full segment */
+    for (int count = 1; count <= 1460; count = (count < 200) ? count + 1 : count + 630)
+    {
+        struct fs_file file;
+        int len, body_len;
+
+        post_body(whole, 1, "framing");
+        CHECK(fs_open_custom(&file, "/echo"), "count %d: open", count);
+
+        len = read_response(&file, count);
+        body_len = (len < 0) ? -1 : decode_chunked(response, len, decoded, LWIP_MAX(count, CHUNK_OVERHEAD + 1));
+        CHECK(body_len == BODY_LEN && !memcmp(decoded, body, BODY_LEN), "count %d: body differs after decoding", count);
+
+        fs_close_custom(&file);
+    }
+}
+
+static void test_max_chunk(void)
+{
+    static char decoded[MAX_RESPONSE];
+    struct fs_file file;
+    int len, body_len, ok = 1;
+
+    CHECK(fs_open_custom(&file, "/big"), "open /big");
+
+    len = read_response(&file, BIG_LEN);
+    body_len = (len < 0) ? -1 : decode_chunked(response, len, decoded, CHUNK_MAX_LEN + CHUNK_OVERHEAD);
+    CHECK(body_len == BIG_LEN, "/big: body of %d bytes", body_len);
+    CHECK(strstr(response, "\r\n\r\nffff\r\n") != NULL, "/big: first chunk is not the maximum size");
+
+    for (int i = 0; i < body_len && ok; i++)
+        ok = (decoded[i] == 'a' + i % 26);
+    CHECK(ok, "/big: body differs after decoding");
+
+    fs_close_custom(&file);
+}
+
+static void request_line(struct tcp_pcb *pcb, const char *request)
+{
+    u16_t len = (u16_t)strlen(request);
+    struct pbuf *p = pbuf_alloc_chain(request, &len, 1);
+
+    CHECK(http_stream_tcp_input(pcb, p) == ERR_OK, "tcp input hook");
+    pbuf_free(p);
+}
+
+static void test_http10(void)
+{
+    struct tcp_pcb pcb = { 80 };
+    struct fs_file file;
+    const char *p;
+    int len, ok = 1;
+
+    request_line(&pcb, "GET /big HTTP/1.0\r\nHost: 192.168.7.1\r\n\r\n");
+    CHECK(fs_open_custom(&file, "/big"), "HTTP/1.0: open");
+
+    len = read_response(&file, 1460);
+    p = strstr(response, "\r\n\r\n");
+    CHECK(p && !strstr(response, "Transfer-Encoding"), "HTTP/1.0: chunked header sent");
+    CHECK(p && len - (p + 4 - response) == BIG_LEN, "HTTP/1.0: body is not the raw %d bytes", BIG_LEN);
+
+    for (int i = 0; p && i < BIG_LEN && ok; i++)
+        ok = (p[4 + i] == 'a' + i % 26);
+    CHECK(ok, "HTTP/1.0: body differs");
+    fs_close_custom(&file);
+
+    /* the next request on the connection asks for HTTP/1.1 */
+    request_line(&pcb, "GET /big HTTP/1.1\r\nHost: 192.168.7.1\r\n\r\n");
+    CHECK(fs_open_custom(&file, "/big"), "HTTP/1.1: open");
+    read_response(&file, 1460);
+    CHECK(strstr(response, "Transfer-Encoding: chunked\r\n") != NULL, "HTTP/1.1 after 1.0: not chunked");
+    fs_close_custom(&file);
+}
+
+static void test_post_body_not_scanned(void)
+{
+    static const char segment[] = "PUT /x HTTP/1.1\r\nlooks like a request line";
+    struct tcp_pcb pcb = { 80 };
+    char response_uri[64] = "";
+    u8_t auto_wnd = 0;
+    int connection;
+    u16_t len = sizeof(segment) - 1;
+    struct pbuf *p;
+    struct fs_file file;
+
+    request_line(&pcb, "POST /echo HTTP/1.0\r\nContent-Length: 44\r\n\r\n");
+    CHECK(httpd_post_begin(&connection, "/echo", "", 0, len, response_uri, sizeof(response_uri), &auto_wnd) == ERR_OK,
+          "POST HTTP/1.0: post_begin");
+
+    /* the body goes through the hook too, and must not be taken for a request line */
+    p = pbuf_alloc_chain(segment, &len, 1);
+    CHECK(http_stream_tcp_input(&pcb, p) == ERR_OK, "tcp input hook");
+    CHECK(httpd_post_receive_data(&connection, p) == ERR_OK, "POST HTTP/1.0: receive_data");
+    httpd_post_finished(&connection, response_uri, sizeof(response_uri));
+
+    CHECK(fs_open_custom(&file, response_uri), "POST HTTP/1.0: open");
+    read_response(&file, 1460);
+    CHECK(!strstr(response, "Transfer-Encoding") && strstr(response, "looks like a request line"),
+          "POST HTTP/1.0: body segment changed the HTTP version");
+    fs_close_custom(&file);
+}
+
+int main(void)
+{
+    for (int i = 0; i < BODY_LEN; i++)
+        body[i] = (char)(i * 7 + 3);
+
+    http_stream_set_handlers(handlers, LWIP_ARRAYSIZE(handlers));
+
+    test_post_splits();
+    test_echo_framing();
+    test_max_chunk();
+    test_http10();
+    test_post_body_not_scanned();
+
+    printf("test_http_stream: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
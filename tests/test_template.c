@@ -0,0 +1,140 @@
+/*
+ * Host test for template.c: renders templates/index.html, compiled by
+ * maketemplates, through tmpl_respond() and compares it with the page
+ * substituted by hand. Built and run by tests/run-tests.sh.
+ */
+
+#include "template.h"
+#include "tmpldata.h"
+#include "lwip/mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PAGE    8192
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static int fills;
+
+static void index_fill(tmpl_value_t *values)
+{
+    values[TMPL_INDEX_HTML_LED].s = "<on> & \"off\"";
+    values[TMPL_INDEX_HTML_UPTIME].u = 4294967295u;
+    values[TMPL_INDEX_HTML_BOARD_ID].s = "E6614103E7'2B";
+    fills++;
+}
+
+static const tmpl_page_t index_page = {
+    &tmpl_index_html,
+    index_fill
+};
+
+static const http_stream_handler_t handler = {
+    .uri = "/index.html",
+    .arg = &index_page,
+    .respond = tmpl_respond,
+    .close = tmpl_close
+};
+
+static char expected[MAX_PAGE];
+static int expected_len;
+
+static void replace(const char *slot, const char *value)
+{
+    char *p = strstr(expected, slot);
+    size_t slot_len = strlen(slot), value_len = strlen(value);
+
+    if (!p)
+    {
+        CHECK(0, "%s not in the page", slot);
+        return;
+    }
+
+    memmove(p + value_len, p + slot_len, expected_len - (p - expected) - slot_len + 1);
+    memcpy(p, value, value_len);
+    expected_len += (int)value_len - (int)slot_len;
+}
+
+static int load_expected(void)
+{
+    FILE *f = fopen("templates/index.html", "rb");
+
+    if (!f)
+        return -1;
+
+    expected_len = (int)fread(expected, 1, MAX_PAGE / 2, f);
+    expected[expected_len] = '\0';
+    fclose(f);
+
+    replace("{{str:led}}", "&lt;on&gt; &amp; &quot;off&quot;");
+    replace("{{uint:uptime}}", "4294967295");
+    replace("{{str:board_id}}", "E6614103E7&#39;2B");
+
+    return 0;
+}
+
+/* render the page with buffers of len bytes; returns its length */
+static int render(char *out, int len)
+{
+    struct http_stream s = { .handler = &handler };
+    int total = 0, n;
+
+    while ((n = tmpl_respond(&s, out + total, LWIP_MIN(len, MAX_PAGE - total))) > 0)
+        total += n;
+
+    CHECK(n == HTTP_STREAM_DONE, "len %d: respond returned %d", len, n);
+    tmpl_close(&s);
+
+    return total;
+}
+
+static void test_buffer_sizes(void)
+{
+    static char out[MAX_PAGE];
+
+    for (int len = 1; len <= expected_len + 1; len++)
+    {
+        int n = render(out, len);
+
+        CHECK(n == expected_len && !memcmp(out, expected, expected_len), "len %d: page differs", len);
+    }
+}
+
+static void test_out_of_memory(void)
+{
+    static char out[MAX_PAGE];
+    struct http_stream s = { .handler = &handler };
+    int n;
+
+    /* must not end the response early; the retry works once there is memory */
+    fills = 0;
+    mem_fail_count = 1;
+    n = tmpl_respond(&s, out, MAX_PAGE);
+    CHECK(n == HTTP_STREAM_PENDING, "failed allocation returned %d", n);
+    CHECK(fills == 0 && s.state == NULL, "filled without memory");
+
+    n = tmpl_respond(&s, out, MAX_PAGE);
+    CHECK(n == expected_len && !memcmp(out, expected, expected_len), "retry after failed allocation");
+    CHECK(fills == 1, "filled %d times", fills);
+    tmpl_close(&s);
+}
+
+int main(void)
+{
+    if (load_expected())
+    {
+        printf("test_template: run from the top of the repository\n");
+        return 1;
+    }
+
+    test_buffer_sizes();
+    test_out_of_memory();
+
+    printf("test_template: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
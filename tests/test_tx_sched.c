@@ -0,0 +1,304 @@
+/*
+ * Host test for tx_sched.c: queues frames the way linkoutput does, lets a
+ * stubbed USB driver take them and checks the order they went out in.
+ * Built and run by tests/run-tests.sh.
+ */
+
+#include "tx_sched.h"
+#include "capture.h"
+#include "boot_trace.h"
+#include "tusb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HDR_LEN     (14 + 20 + 20)
+#define FULL_LEN    1514
+#define MAX_SENT    256
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+/* stubbed USB driver: takes up to link_credit frames, -1 for any number */
+static int link_credit;
+static struct { u16_t dst; u16_t len; struct pbuf *p; } sent[MAX_SENT];
+static int num_sent;
+
+bool tud_ready(void)
+{
+    return true;
+}
+
+bool tud_network_can_xmit(void)
+{
+    return link_credit != 0;
+}
+
+void tud_network_xmit(void *ref, uint16_t arg)
+{
+    struct pbuf *p = (struct pbuf *)ref;
+    const u8_t *frame = (const u8_t *)p->payload;
+
+    (void)arg;
+
+    if (link_credit > 0)
+        link_credit--;
+
+    if (num_sent < MAX_SENT)
+    {
+        /* client port, or 0 for what is not TCP */
+        sent[num_sent].dst = (frame[12] == 0x08 && frame[13] == 0x00) ? (frame[36] << 8) | frame[37] : 0;
+        sent[num_sent].len = p->tot_len;
+        sent[num_sent].p = p;
+    }
+    num_sent++;
+}
+
+/* the rest of the firmware tx_sched.c calls into */
+bool capture_enabled;
+
+void capture_pbuf(uint8_t dir, struct pbuf *p)
+{
+    (void)dir;
+    (void)p;
+}
+
+bool boot_trace_done(boot_phase_t phase)
+{
+    (void)phase;
+    return true;
+}
+
+void boot_trace_mark(boot_phase_t phase)
+{
+    (void)phase;
+}
+
+/* IPv4 TCP frame from port 80 to dst with payload bytes of data */
+static struct pbuf *tcp_frame(u16_t dst, u16_t payload)
+{
+    static u8_t frame[FULL_LEN];
+    u16_t len = HDR_LEN + payload, ip_len = 20 + 20 + payload;
+
+    memset(frame, 0, sizeof(frame));
+    frame[12] = 0x08;
+    frame[14] = 0x45;
+    frame[16] = ip_len >> 8;
+    frame[17] = ip_len & 0xFF;
+    frame[23] = 6;
+    frame[35] = 80;
+    frame[36] = dst >> 8;
+    frame[37] = dst & 0xFF;
+    frame[46] = 0x50;
+
+    return pbuf_alloc_chain(frame, &len, 1);
+}
+
+static struct pbuf *arp_frame(void)
+{
+    static const u8_t frame[42] = { [12] = 0x08, [13] = 0x06 };
+    u16_t len = sizeof(frame);
+
+    return pbuf_alloc_chain(frame, &len, 1);
+}
+
+/* what linkoutput's caller does: tx_sched keeps its own reference */
+static err_t enqueue(struct pbuf *p)
+{
+    err_t err = tx_sched_enqueue(p);
+
+    pbuf_free(p);
+    return err;
+}
+
+static void send_all(void)
+{
+    link_credit = -1;
+    tx_sched_run();
+    link_credit = 0;
+}
+
+static void reset(void)
+{
+    link_credit = 0;
+    tx_sched_flush();
+    num_sent = 0;
+}
+
+/* make a flow bulk by sending more than TX_SCHED_SHORT_BYTES through it */
+static void make_bulk(u16_t dst)
+{
+    for (int sent_bytes = 0; sent_bytes <= TX_SCHED_SHORT_BYTES; sent_bytes += FULL_LEN)
+    {
+        enqueue(tcp_frame(dst, FULL_LEN - HDR_LEN));
+        send_all();
+    }
+}
+
+/* of the first n frames sent since first, how many went to dst */
+static int count_sent(int first, int n, u16_t dst)
+{
+    int count = 0;
+
+    for (int i = first; i < first + n && i < num_sent; i++)
+        count += (sent[i].dst == dst);
+
+    return count;
+}
+
+static void test_control_first(void)
+{
+    reset();
+
+    for (int i = 0; i < 3; i++)
+        enqueue(tcp_frame(1000, 1000));
+    enqueue(arp_frame());
+    enqueue(tcp_frame(2000, 0));
+
+    send_all();
+    CHECK(num_sent == 5, "sent %d frames", num_sent);
+    CHECK(sent[0].dst == 0 && sent[0].len == 42, "ARP did not go first");
+    CHECK(sent[1].dst == 2000 && sent[1].len == HDR_LEN, "ACK of an idle connection did not go second");
+}
+
+static void test_fin_behind_data(void)
+{
+    reset();
+
+    enqueue(tcp_frame(1000, 1000));
+    enqueue(tcp_frame(1000, 1000));
+    enqueue(tcp_frame(1000, 0));        /* FIN */
+    enqueue(arp_frame());
+
+    send_all();
+    CHECK(num_sent == 4, "sent %d frames", num_sent);
+    CHECK(sent[0].dst == 0, "ARP did not go first");
+    CHECK(sent[1].len == HDR_LEN + 1000 && sent[2].len == HDR_LEN + 1000, "data did not go before the FIN");
+    CHECK(sent[3].dst == 1000 && sent[3].len == HDR_LEN, "FIN overtook its data");
+}
+
+static void test_short_before_bulk(void)
+{
+    int first;
+
+    reset();
+    make_bulk(1000);
+    first = num_sent;
+
+    for (int i = 0; i < 8; i++)
+    {
+        enqueue(tcp_frame(1000, FULL_LEN - HDR_LEN));
+        enqueue(tcp_frame(2000, FULL_LEN - HDR_LEN));
+    }
+
+    send_all();
+    CHECK(num_sent - first == 16, "sent %d frames", num_sent - first);
+
+    /* per round the short flow gets TX_SCHED_SHORT_WEIGHT full frames, the bulk one TX_SCHED_BULK_WEIGHT */
+    CHECK(count_sent(first, 2 * (TX_SCHED_SHORT_WEIGHT + TX_SCHED_BULK_WEIGHT), 2000) == 2 * TX_SCHED_SHORT_WEIGHT,
+          "short flow sent %d of the first %d frames",
+          count_sent(first, 2 * (TX_SCHED_SHORT_WEIGHT + TX_SCHED_BULK_WEIGHT), 2000),
+          2 * (TX_SCHED_SHORT_WEIGHT + TX_SCHED_BULK_WEIGHT));
+}
+
+static void test_lru_reuse(void)
+{
+    int first;
+
+    reset();
+
+    /* two bulk flows, the oldest first, then six more to use up the table */
+    make_bulk(1000);
+    make_bulk(2000);
+    for (int i = 0; i < TX_SCHED_MAX_FLOWS - 2; i++)
+    {
+        enqueue(tcp_frame(3000 + i, 100));
+        send_all();
+    }
+
+    /* 1000 is the most recent again, so a new connection takes the slot of 2000 */
+    enqueue(tcp_frame(1000, 100));
+    send_all();
+    enqueue(tcp_frame(4000, 100));
+    send_all();
+
+    /* 2000 comes back as a new, short flow; 1000 is still bulk */
+    first = num_sent;
+    for (int i = 0; i < 8; i++)
+    {
+        enqueue(tcp_frame(1000, FULL_LEN - HDR_LEN));
+        enqueue(tcp_frame(2000, FULL_LEN - HDR_LEN));
+    }
+    send_all();
+
+    CHECK(count_sent(first, 2 * (TX_SCHED_SHORT_WEIGHT + TX_SCHED_BULK_WEIGHT), 2000) == 2 * TX_SCHED_SHORT_WEIGHT,
+          "the least recently used flow was not the one reused");
+}
+
+static void test_full(void)
+{
+    struct pbuf *p;
+    err_t err;
+
+    reset();
+
+    /* a queued frame must outlive lwIP's own reference */
+    p = tcp_frame(1000, 100);
+    CHECK(tx_sched_enqueue(p) == ERR_OK && p->ref == 2, "no reference taken on a queued frame");
+    pbuf_free(p);
+
+    for (int i = 1; i < TX_SCHED_MAX_FRAMES; i++)
+        CHECK(enqueue(tcp_frame(1000 + i % 3, 100)) == ERR_OK, "frame %d not queued", i);
+
+    p = tcp_frame(2000, 100);
+    err = tx_sched_enqueue(p);
+    CHECK(err == ERR_MEM, "full queue returned %d", err);
+    CHECK(p->ref == 1, "kept a reference to a frame it did not queue");
+    pbuf_free(p);
+
+    p = arp_frame();
+    CHECK(tx_sched_enqueue(p) == ERR_MEM, "full queue took a control frame");
+    pbuf_free(p);
+
+    /* room again once the driver took one */
+    link_credit = 1;
+    tx_sched_run();
+    CHECK(num_sent == 1, "sent %d frames with credit for one", num_sent);
+    CHECK(enqueue(tcp_frame(2000, 100)) == ERR_OK, "no room after a frame went out");
+
+    send_all();
+    CHECK(num_sent == TX_SCHED_MAX_FRAMES + 1, "sent %d frames", num_sent);
+}
+
+/* a flow with queued data is never reused, so with every flow busy new data must wait */
+static void test_no_free_flow(void)
+{
+    reset();
+
+    for (int i = 0; i < TX_SCHED_MAX_FLOWS; i++)
+        CHECK(enqueue(tcp_frame(1000 + i, 100)) == ERR_OK, "flow %d not queued", i);
+
+    CHECK(enqueue(tcp_frame(2000, 100)) == ERR_MEM, "data queued without a free flow");
+    CHECK(enqueue(tcp_frame(2000, 0)) == ERR_OK, "ACK of a new connection not queued");
+
+    send_all();
+    CHECK(num_sent == TX_SCHED_MAX_FLOWS + 1, "sent %d frames", num_sent);
+}
+
+int main(void)
+{
+    test_control_first();
+    test_fin_behind_data();
+    test_short_before_bulk();
+    test_lru_reuse();
+    test_full();
+    test_no_free_flow();
+
+    reset();
+
+    printf("test_tx_sched: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -27,7 +27,65 @@
  */
 
 #include "tusb_lwip_glue.h"
+#include "boot_trace.h"
+#include "tx_sched.h"
+#include "capture.h"
 #include "pico/unique_id.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip.h"
+#include "lwip/ip4.h"
+#include "netif/ethernet.h"
+#include "netif/etharp.h"
+
+/* the USB link has exactly one peer, the host; once its MAC is known, IPv4 skips ARP and the L2 demux */
+#ifndef P2P_FAST_PATH
+#define P2P_FAST_PATH 1
+#endif
+
+/*
+ * cycles spent in output_fn() and in handing a received frame to lwIP, to compare
+ * P2P_FAST_PATH=0 and 1; read them with a debugger, e.g. "print p2p_profile"
+ */
+#ifndef P2P_PROFILE
+#define P2P_PROFILE 0
+#endif
+
+#if P2P_PROFILE
+#include "hardware/structs/systick.h"
+
+struct p2p_cycles
+{
+    uint32_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+};
+
+struct
+{
+    struct p2p_cycles tx;
+    struct p2p_cycles rx;
+} p2p_profile;
+
+/* SysTick counts processor cycles down, 24 bits wide, so one packet never wraps it */
+static void p2p_cycles_add(struct p2p_cycles *c, uint32_t start)
+{
+    uint32_t n = (start - systick_hw->cvr) & 0xFFFFFF;
+    
+    if (!c->count || n < c->min)
+      c->min = n;
+    if (n > c->max)
+      c->max = n;
+    c->total += n;
+    c->count++;
+}
+
+#define P2P_PROFILE_START()     uint32_t p2p_profile_start = systick_hw->cvr
+#define P2P_PROFILE_END(dir)    p2p_cycles_add(&p2p_profile.dir, p2p_profile_start)
+#else
+#define P2P_PROFILE_START()
+#define P2P_PROFILE_END(dir)
+#endif
 
 /* lwip context */
 static struct netif netif_data;
@@ -35,6 +93,20 @@ static struct netif netif_data;
 /* shared between tud_network_recv_cb() and service_traffic() */
 static struct pbuf *received_frame;
 
+/* set when dhserv_init() failed; service_traffic() retries instead of spinning here */
+static bool dhcpd_pending;
+
+#if P2P_FAST_PATH
+/* learnt from the first frame the host sends, normally its DHCP discover; reset when the link restarts */
+static struct eth_addr peer_mac;
+static enum
+{
+    PEER_UNKNOWN = 0,
+    PEER_KNOWN,
+    PEER_CONFLICT   /* more than one MAC seen, leave it all to ARP */
+} peer_state;
+#endif
+
 /* this is used by this code, ./class/net/net_driver.c, and usb_descriptors.c */
 /* ideally speaking, this should be generated from the hardware's unique ID (if available) */
 /* it is suggested that the first byte is 0x02 to indicate a link-local address */
@@ -66,30 +138,66 @@ static const dhcp_config_t dhcp_config =
 
 static err_t linkoutput_fn(struct netif *netif, struct pbuf *p)
 {
+    err_t err;
+    
     (void)netif;
     
-    for (;;)
-    {
-      /* if TinyUSB isn't ready, we must signal back to lwip that there is nothing we can do */
-      if (!tud_ready())
-        return ERR_USE;
+    /* if TinyUSB isn't ready, we must signal back to lwip that there is nothing we can do */
+    if (!tud_ready())
+      return ERR_USE;
     
-      /* if the network driver can accept another packet, we make it happen */
-      if (tud_network_can_xmit())
-      {
-        tud_network_xmit(p, 0 /* unused for this example */);
-        return ERR_OK;
-      }
+    /* queue the frame rather than waiting for the driver; tx_sched_run() sends in priority order */
+    err = tx_sched_enqueue(p);
+    tx_sched_run();
     
-      /* transfer execution to TinyUSB in the hopes that it will finish transmitting the prior packet */
-      tud_task();
-    }
+    return err;
 }
 
 static err_t output_fn(struct netif *netif, struct pbuf *p, const ip_addr_t *addr)
 {
-    return etharp_output(netif, p, addr);
+    err_t err;
+    P2P_PROFILE_START();
+    
+#if P2P_FAST_PATH
+    /* every unicast goes to the host, no need to look up or resolve its address */
+    if (peer_state == PEER_KNOWN && !ip4_addr_isbroadcast(addr, netif) && !ip4_addr_ismulticast(addr))
+      err = ethernet_output(netif, p, (const struct eth_addr *)netif->hwaddr, &peer_mac, ETHTYPE_IP);
+    else
+#endif
+      err = etharp_output(netif, p, addr);
+    
+    P2P_PROFILE_END(tx);
+    return err;
+}
+
+#if P2P_FAST_PATH
+/* hand unicast IPv4 from the host straight to the IP layer; returns false if ethernet_input() should take it */
+static bool p2p_input(struct pbuf *p)
+{
+    const struct eth_hdr *eth = (const struct eth_hdr *)p->payload;
+    
+    if (p->len < SIZEOF_ETH_HDR || (eth->src.addr[0] & 0x01))
+      return false;
+    
+    if (peer_state == PEER_UNKNOWN)
+    {
+      peer_mac = eth->src;
+      peer_state = PEER_KNOWN;
+    }
+    else if (peer_state == PEER_KNOWN && !eth_addr_cmp(&eth->src, &peer_mac))
+    {
+      peer_state = PEER_CONFLICT;
+    }
+    
+    if (peer_state != PEER_KNOWN || eth->type != PP_HTONS(ETHTYPE_IP) ||
+        memcmp(eth->dest.addr, netif_data.hwaddr, ETH_HWADDR_LEN))
+      return false;
+    
+    pbuf_remove_header(p, SIZEOF_ETH_HDR);
+    ip4_input(p, &netif_data);
+    return true;
 }
+#endif
 
 static err_t netif_init_cb(struct netif *netif)
 {
@@ -114,7 +222,13 @@ void init_lwip(void)
     //memcpy( (tud_network_mac_address)+1, id.id, 5);
     // Fixing up does not work because tud_network_mac_address is const
     
-    /* Initialize tinyUSB */
+#if P2P_PROFILE
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+#endif
+    
+    /* Initialize tinyUSB first, the host can start enumerating while we set up the rest */
     tusb_init();
     
     /* Initialize lwip */
@@ -129,14 +243,29 @@ void init_lwip(void)
     netif_set_default(netif);
 }
 
+void tud_mount_cb(void)
+{
+    boot_trace_mark(BOOT_USB_ENUMERATED);
+}
+
 void tud_network_init_cb(void)
 {
+    /* the host has configured the interface on its side (RNDIS init or ECM interface selected) */
+    boot_trace_mark(BOOT_NETIF_UP);
+    
     /* if the network is re-initializing and we have a leftover packet, we must do a cleanup */
     if (received_frame)
     {
       pbuf_free(received_frame);
       received_frame = NULL;
     }
+    
+    tx_sched_flush();
+    
+#if P2P_FAST_PATH
+    /* possibly a different host now */
+    peer_state = PEER_UNKNOWN;
+#endif
 }
 
 bool tud_network_recv_cb(const uint8_t *src, uint16_t size)
@@ -153,6 +282,7 @@ bool tud_network_recv_cb(const uint8_t *src, uint16_t size)
         {
             /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
             memcpy(p->payload, src, size);
+            CAPTURE_FRAME(CAPTURE_RX, src, size);
         
             /* store away the pointer for service_traffic() to later handle */
             received_frame = p;
@@ -187,23 +317,46 @@ void service_traffic(void)
     /* handle any packet received by tud_network_recv_cb() */
     if (received_frame)
     {
-      ethernet_input(received_frame, &netif_data);
-      pbuf_free(received_frame);
+      struct pbuf *p = received_frame;
+      
+      /* the input functions take ownership of the frame */
       received_frame = NULL;
+      P2P_PROFILE_START();
+#if P2P_FAST_PATH
+      if (!p2p_input(p))
+#endif
+        ethernet_input(p, &netif_data);
+      P2P_PROFILE_END(rx);
       tud_network_recv_renew();
     }
     
+    /* the USB driver may have finished the previous frame since the last call */
+    tx_sched_run();
+    
+    if (dhcpd_pending)
+      dhcpd_pending = (dhserv_init(&dhcp_config) != ERR_OK);
+    
+    /* dhserver has no callback, but it records the host's MAC in the entry it hands out */
+    if (!boot_trace_done(BOOT_DHCP_LEASE))
+    {
+      static const uint8_t no_mac[6];
+      
+      for (size_t i = 0; i < TU_ARRAY_SIZE(entries); i++)
+      {
+        if (memcmp(entries[i].mac, no_mac, sizeof(no_mac)))
+        {
+          boot_trace_mark(BOOT_DHCP_LEASE);
+          break;
+        }
+      }
+    }
+    
     sys_check_timeouts();
 }
 
 void dhcpd_init()
 {
-    while (dhserv_init(&dhcp_config) != ERR_OK);    
-}
-
-void wait_for_netif_is_up()
-{
-    while (!netif_is_up(&netif_data));    
+    dhcpd_pending = (dhserv_init(&dhcp_config) != ERR_OK);
 }
 
 
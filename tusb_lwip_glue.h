@@ -13,7 +13,6 @@
 #include "lwip/apps/httpd.h"
 
 void init_lwip();
-void wait_for_netif_is_up();
 void dhcpd_init();
 void service_traffic();
 
@@ -0,0 +1,292 @@
+#include "tx_sched.h"
+#include "tcp_frame.h"
+#include "capture.h"
+#include "boot_trace.h"
+
+#include "tusb.h"
+
+#include <string.h>
+
+#define NO_FRAME    0xFF
+
+/* frame indices are uint8_t, with NO_FRAME as the end of a list */
+#if TX_SCHED_MAX_FRAMES >= NO_FRAME
+#error "TX_SCHED_MAX_FRAMES must be less than 255"
+#endif
+
+struct tx_frame
+{
+    struct pbuf *p;
+    uint8_t next;
+};
+
+struct tx_queue
+{
+    uint8_t head;
+    uint8_t tail;
+};
+
+struct tx_flow
+{
+    uint32_t key;           /* local port << 16 | remote port, 0 if unused */
+    uint32_t attained;      /* bytes sent so far */
+    uint32_t pending;       /* bytes queued */
+    uint32_t last_used;
+    int32_t deficit;
+    bool visited;           /* quantum already added this round */
+    struct tx_queue queue;
+};
+
+static struct tx_frame frames[TX_SCHED_MAX_FRAMES];
+static uint8_t free_frames;
+
+/* ARP, DHCP, ICMP and bare TCP control segments, always sent first */
+static struct tx_queue control_queue;
+
+static struct tx_flow flows[TX_SCHED_MAX_FLOWS];
+static uint8_t current_flow;
+static uint32_t use_counter;
+
+static bool initialized;
+
+static void sched_init(void)
+{
+    for (int i = 0; i < TX_SCHED_MAX_FRAMES; i++)
+    {
+        frames[i].p = NULL;
+        frames[i].next = (i + 1 < TX_SCHED_MAX_FRAMES) ? i + 1 : NO_FRAME;
+    }
+    free_frames = 0;
+
+    control_queue.head = control_queue.tail = NO_FRAME;
+
+    for (int i = 0; i < TX_SCHED_MAX_FLOWS; i++)
+    {
+        memset(&flows[i], 0, sizeof(flows[i]));
+        flows[i].queue.head = flows[i].queue.tail = NO_FRAME;
+    }
+    current_flow = 0;
+
+    initialized = true;
+}
+
+static void queue_push(struct tx_queue *q, uint8_t f)
+{
+    frames[f].next = NO_FRAME;
+
+    if (q->tail == NO_FRAME)
+        q->head = f;
+    else
+        frames[q->tail].next = f;
+    q->tail = f;
+}
+
+static struct pbuf *queue_pop(struct tx_queue *q)
+{
+    uint8_t f = q->head;
+    struct pbuf *p = frames[f].p;
+
+    q->head = frames[f].next;
+    if (q->head == NO_FRAME)
+        q->tail = NO_FRAME;
+
+    frames[f].p = NULL;
+    frames[f].next = free_frames;
+    free_frames = f;
+
+    return p;
+}
+
+/* ports of an IPv4 TCP frame, 0 for anything else */
+static uint32_t tcp_key(struct pbuf *p, bool *has_data)
+{
+    uint16_t src, dst;
+
+    if (!tcp_frame_ports((const uint8_t *)p->payload, p->len, &src, &dst, has_data))
+        return 0;
+
+    return ((uint32_t)src << 16) | dst;
+}
+
+/* TCP data from port 80 */
+static bool is_http_data(struct pbuf *p)
+{
+    uint16_t src, dst;
+    bool has_data;
+
+    return tcp_frame_ports((const uint8_t *)p->payload, p->len, &src, &dst, &has_data) && src == 80 && has_data;
+}
+
+static struct tx_flow *find_flow(uint32_t key)
+{
+    for (int i = 0; i < TX_SCHED_MAX_FLOWS; i++)
+    {
+        if (flows[i].key == key)
+            return &flows[i];
+    }
+
+    return NULL;
+}
+
+static struct tx_flow *flow_for_key(uint32_t key)
+{
+    struct tx_flow *victim = find_flow(key);
+
+    if (victim)
+        return victim;
+
+    for (int i = 0; i < TX_SCHED_MAX_FLOWS; i++)
+    {
+        /* reuse the idle flow that was used longest ago */
+        if (flows[i].queue.head == NO_FRAME && (!victim || flows[i].last_used < victim->last_used))
+            victim = &flows[i];
+    }
+
+    if (victim)
+    {
+        memset(victim, 0, sizeof(*victim));
+        victim->queue.head = victim->queue.tail = NO_FRAME;
+        victim->key = key;
+    }
+
+    return victim;
+}
+
+err_t tx_sched_enqueue(struct pbuf *p)
+{
+    uint32_t key;
+    bool has_data = false;
+    struct tx_flow *flow = NULL;
+    uint8_t f;
+
+    if (!initialized)
+        sched_init();
+
+    if (free_frames == NO_FRAME)
+        return ERR_MEM;
+
+    key = tcp_key(p, &has_data);
+    if (key && has_data)
+    {
+        flow = flow_for_key(key);
+        if (!flow)
+            return ERR_MEM;
+    }
+    else if (key)
+    {
+        /* a FIN or RST must not overtake data still queued on its connection */
+        flow = find_flow(key);
+        if (flow && flow->queue.head == NO_FRAME)
+            flow = NULL;
+    }
+
+    /* lwIP does not retransmit a segment while we hold a reference to it */
+    pbuf_ref(p);
+
+    f = free_frames;
+    free_frames = frames[f].next;
+    frames[f].p = p;
+
+    if (flow)
+    {
+        queue_push(&flow->queue, f);
+        flow->pending += p->tot_len;
+        flow->last_used = ++use_counter;
+    }
+    else
+    {
+        queue_push(&control_queue, f);
+    }
+
+    return ERR_OK;
+}
+
+static int32_t flow_quantum(const struct tx_flow *flow)
+{
+    int weight = (flow->attained < TX_SCHED_SHORT_BYTES) ? TX_SCHED_SHORT_WEIGHT : TX_SCHED_BULK_WEIGHT;
+
+    return TX_SCHED_QUANTUM * weight;
+}
+
+/* deficit round-robin over the flows with queued frames */
+static struct pbuf *next_flow_frame(void)
+{
+    for (int visits = 0; visits < 2 * TX_SCHED_MAX_FLOWS + 1; )
+    {
+        struct tx_flow *flow = &flows[current_flow];
+        struct pbuf *p;
+
+        if (flow->queue.head == NO_FRAME)
+        {
+            flow->deficit = 0;
+            flow->visited = false;
+            current_flow = (current_flow + 1) % TX_SCHED_MAX_FLOWS;
+            visits++;
+            continue;
+        }
+
+        if (!flow->visited)
+        {
+            flow->deficit += flow_quantum(flow);
+            flow->visited = true;
+        }
+
+        p = frames[flow->queue.head].p;
+        if (flow->deficit >= p->tot_len)
+        {
+            flow->deficit -= p->tot_len;
+            flow->pending -= p->tot_len;
+            flow->attained += p->tot_len;
+            return queue_pop(&flow->queue);
+        }
+
+        /* used up its quantum for this round */
+        flow->visited = false;
+        current_flow = (current_flow + 1) % TX_SCHED_MAX_FLOWS;
+        visits++;
+    }
+
+    return NULL;
+}
+
+void tx_sched_run(void)
+{
+    if (!initialized)
+        return;
+
+    while (tud_ready() && tud_network_can_xmit())
+    {
+        struct pbuf *p;
+
+        if (control_queue.head != NO_FRAME)
+            p = queue_pop(&control_queue);
+        else
+            p = next_flow_frame();
+
+        if (!p)
+            break;
+
+        /* recorded when it actually goes to the host, not when lwIP queued it */
+        CAPTURE_PBUF(CAPTURE_TX, p);
+        if (!boot_trace_done(BOOT_FIRST_HTTP_BYTE) && is_http_data(p))
+            boot_trace_mark(BOOT_FIRST_HTTP_BYTE);
+
+        /* tud_network_xmit_cb() copies the frame, so it can be released right away */
+        tud_network_xmit(p, 0);
+        pbuf_free(p);
+    }
+}
+
+void tx_sched_flush(void)
+{
+    if (!initialized)
+        return;
+
+    for (int i = 0; i < TX_SCHED_MAX_FRAMES; i++)
+    {
+        if (frames[i].p)
+            pbuf_free(frames[i].p);
+    }
+
+    sched_init();
+}
@@ -0,0 +1,63 @@
+#ifndef _TX_SCHED_H_
+#define _TX_SCHED_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "lwip/pbuf.h"
+#include "lwip/err.h"
+
+/*
+ * Transmit scheduler between lwIP and the single USB TX path.
+ *
+ * linkoutput queues frames here instead of spinning until the USB driver is
+ * free. Frames without TCP payload (ARP, DHCP, ICMP, ACK/SYN/FIN) go first.
+ * TCP data is kept per connection and served deficit round-robin; a
+ * connection that has sent less than TX_SCHED_SHORT_BYTES so far (a small
+ * response like an HTML page or /toggle_led, or the start of any response)
+ * gets TX_SCHED_SHORT_WEIGHT quanta per round, a bulk download only
+ * TX_SCHED_BULK_WEIGHT, so small requests are not stuck behind a large one.
+ */
+
+/* frames queued at most; lwIP retries a TCP segment that did not fit */
+#ifndef TX_SCHED_MAX_FRAMES
+#define TX_SCHED_MAX_FRAMES     16
+#endif
+
+/* connections tracked at once */
+#ifndef TX_SCHED_MAX_FLOWS
+#define TX_SCHED_MAX_FLOWS      8
+#endif
+
+/* bytes a flow may send per round, per unit of weight */
+#ifndef TX_SCHED_QUANTUM
+#define TX_SCHED_QUANTUM        1514
+#endif
+
+#ifndef TX_SCHED_SHORT_BYTES
+#define TX_SCHED_SHORT_BYTES    (16 * 1024)
+#endif
+
+#ifndef TX_SCHED_SHORT_WEIGHT
+#define TX_SCHED_SHORT_WEIGHT   4
+#endif
+
+#ifndef TX_SCHED_BULK_WEIGHT
+#define TX_SCHED_BULK_WEIGHT    1
+#endif
+
+/* takes a reference on p; ERR_MEM if the queue is full */
+err_t tx_sched_enqueue(struct pbuf *p);
+
+/* hand queued frames to the USB driver for as long as it accepts them */
+void tx_sched_run(void);
+
+/* drop everything queued, e.g. when the USB network interface restarts */
+void tx_sched_flush(void);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
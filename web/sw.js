@@ -0,0 +1,58 @@
+// Service worker for the Pico web UI
+//
+// regen-fsdata.sh prepends MANIFEST (version and app shell files) and writes
+// the result to fs_bundle/sw.js. The version changes whenever anything flashed does,
+// so after a reflash the browser's own update check of /sw.js sees a new
+// script, installs it and the old caches are dropped. Until then, pages,
+// scripts and sprites come from the cache without touching the device.
+
+const SHELL_CACHE = `shell-${MANIFEST.version}`;
+const SPRITE_CACHE = `sprites-${MANIFEST.version}`;
+
+self.addEventListener('install', function(event) {
+    event.waitUntil(
+        caches.open(SHELL_CACHE)
+            .then(cache => cache.addAll(MANIFEST.precache))
+            .then(() => self.skipWaiting())
+    );
+});
+
+self.addEventListener('activate', function(event) {
+    event.waitUntil(
+        caches.keys()
+            .then(keys => Promise.all(
+                keys.filter(key => key !== SHELL_CACHE && key !== SPRITE_CACHE)
+                    .map(key => caches.delete(key))
+            ))
+            .then(() => self.clients.claim())
+    );
+});
+
+self.addEventListener('fetch', function(event) {
+    const request = event.request;
+    const url = new URL(request.url);
+
+    // Leave PokeAPI, the dynamic pages and the device controls alone
+    if (request.method !== 'GET' || url.origin !== self.location.origin) {
+        return;
+    }
+
+    // The page loads its scripts with a ?v= cache buster, which the cache ignores
+    if (MANIFEST.precache.includes(url.pathname)) {
+        event.respondWith(
+            caches.match(request, { ignoreSearch: true, cacheName: SHELL_CACHE })
+                .then(response => response || fetch(request))
+        );
+    } else if (url.pathname.startsWith('/sprites/')) {
+        event.respondWith(
+            caches.open(SPRITE_CACHE).then(cache =>
+                cache.match(request).then(cached => cached || fetch(request).then(response => {
+                    if (response.ok) {
+                        cache.put(request, response.clone());
+                    }
+                    return response;
+                }))
+            )
+        );
+    }
+});
@@ -1,9 +1,15 @@
 #include "pico/stdlib.h"
 #include "pico/bootrom.h"
+#include "pico/unique_id.h"
 #include "hardware/watchdog.h"
 #include "hardware/structs/watchdog.h"
 
 #include "tusb_lwip_glue.h"
+#include "boot_trace.h"
+#include "capture.h"
+#include "http_stream.h"
+#include "template.h"
+#include "tmpldata.h"
 #include "lwip/apps/httpd.h"
 
 #include <string.h>
@@ -47,6 +53,29 @@ static const char *cgi_reset_usb_boot(int iIndex, int iNumParams, char *pcParam[
     return "/index.html";
 }
 
+static const char *cgi_capture_start(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    capture_start();
+    return "/index.html";
+}
+
+static const char *cgi_capture_stop(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    capture_stop();
+    return "/index.html";
+}
+
+// /boot.json?save also keeps this boot's timeline in flash, so it survives unplugging
+static const char *cgi_boot_json(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
+{
+    for (int i = 0; i < iNumParams; i++)
+    {
+        if (strcmp(pcParam[i], "save") == 0)
+            boot_trace_save();
+    }
+    return "/boot.json";
+}
+
 // Handler for JavaScript files
 static const char *cgi_serve_js(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
 {
@@ -55,13 +84,6 @@ static const char *cgi_serve_js(int iIndex, int iNumParams, char *pcParam[], cha
     return "/js/pokemon-parser.js";
 }
 
-// Handler for Pokemon data JavaScript file
-static const char *cgi_serve_pokemon_data(int iIndex, int iNumParams, char *pcParam[], char *pcValue[])
-{
-    // This is a special handler for the pokemon-data.js file
-    return "/js/pokemon-data.js";
-}
-
 static const tCGI cgi_handlers[] = {
     {
         "/toggle_led",
@@ -71,33 +93,129 @@ static const tCGI cgi_handlers[] = {
         "/reset_usb_boot",
         cgi_reset_usb_boot
     },
+    {
+        "/capture_start",
+        cgi_capture_start
+    },
+    {
+        "/capture_stop",
+        cgi_capture_stop
+    },
     {
         "/js/pokemon-parser.js",
         cgi_serve_js
     },
     {
-        "/js/pokemon-data.js",
-        cgi_serve_pokemon_data
+        "/boot.json",
+        cgi_boot_json
+    }
+};
+
+// Accepts a POST body of any size without buffering it and reports how much arrived
+static int upload_respond(struct http_stream *s, char *buf, int len)
+{
+    char json[32];
+    int json_len = snprintf(json, sizeof(json), "{\"bytes\":%lu}\n", (unsigned long)s->body_len);
+
+    return http_stream_copy(s, buf, len, json, json_len);
+}
+
+// Device status on the front page, compiled from templates/index.html
+static void index_fill(tmpl_value_t *values)
+{
+    static char board_id[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+
+    if (!board_id[0])
+        pico_get_unique_board_id_string(board_id, sizeof(board_id));
+
+    values[TMPL_INDEX_HTML_LED].s = gpio_get(LED_PIN) ? "on" : "off";
+    values[TMPL_INDEX_HTML_UPTIME].u = to_ms_since_boot(get_absolute_time()) / 1000;
+    values[TMPL_INDEX_HTML_BOARD_ID].s = board_id;
+}
+
+static const tmpl_page_t index_page = {
+    &tmpl_index_html,
+    index_fill
+};
+
+// Boot timeline of this and the previous boot, compiled from templates/boot.json
+static void boot_fill(tmpl_value_t *values)
+{
+    static const uint8_t slots[BOOT_NUM_PHASES][2] = {
+        { TMPL_BOOT_JSON_MAIN,              TMPL_BOOT_JSON_PREV_MAIN },
+        { TMPL_BOOT_JSON_INIT_DONE,         TMPL_BOOT_JSON_PREV_INIT_DONE },
+        { TMPL_BOOT_JSON_USB_ENUMERATED,    TMPL_BOOT_JSON_PREV_USB_ENUMERATED },
+        { TMPL_BOOT_JSON_NETIF_UP,          TMPL_BOOT_JSON_PREV_NETIF_UP },
+        { TMPL_BOOT_JSON_DHCP_LEASE,        TMPL_BOOT_JSON_PREV_DHCP_LEASE },
+        { TMPL_BOOT_JSON_FIRST_HTTP_BYTE,   TMPL_BOOT_JSON_PREV_FIRST_HTTP_BYTE }
+    };
+
+    values[TMPL_BOOT_JSON_COUNT].u = boot_trace_count();
+
+    for (int i = 0; i < BOOT_NUM_PHASES; i++)
+    {
+        values[slots[i][0]].u = boot_trace_get(i, false);
+        values[slots[i][1]].u = boot_trace_get(i, true);
+    }
+}
+
+static const tmpl_page_t boot_page = {
+    &tmpl_boot_json,
+    boot_fill
+};
+
+static const http_stream_handler_t stream_handlers[] = {
+    {
+        .uri = "/index.html",
+        .content_type = "text/html",
+        .arg = &index_page,
+        .respond = tmpl_respond,
+        .close = tmpl_close
+    },
+    {
+        .uri = "/boot.json",
+        .content_type = "application/json",
+        .arg = &boot_page,
+        .respond = tmpl_respond,
+        .close = tmpl_close
+    },
+    {
+        .uri = "/upload",
+        .content_type = "application/json",
+        .respond = upload_respond
+    },
+    {
+        .uri = "/capture.pcap",
+        .content_type = "application/vnd.tcpdump.pcap",
+        .open = capture_open,
+        .respond = capture_respond,
+        .close = capture_close
     }
 };
 
 int main()
 {
+    boot_trace_init();
+
     // Initialize tinyusb, lwip, dhcpd and httpd
+    // None of this waits for the host, enumeration completes once the loop below runs tud_task()
     init_lwip();
-    wait_for_netif_is_up();
     dhcpd_init();
     httpd_init();
     http_set_cgi_handlers(cgi_handlers, LWIP_ARRAYSIZE(cgi_handlers));
+    http_stream_set_handlers(stream_handlers, LWIP_ARRAYSIZE(stream_handlers));
     
     // For toggle_led
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
 
+    boot_trace_mark(BOOT_INIT_DONE);
+
     while (true)
     {
         tud_task();
         service_traffic();
+        boot_trace_task();
     }
 
     return 0;